@@ -0,0 +1,218 @@
+/* file: align_batch.c
+ * description: Smith-Waterman alignment of many short sequence pairs at once
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ * note: Each byte lane of a vector holds a different pair, so the
+ *       recurrence runs along each query without the striped layout, query
+ *       profile or lazy-F loop of local_align.c. Scores, end positions and
+ *       ties come out as local_align would report them: its gap openings
+ *       after a deletion only see deletions begun in the same 16th of the
+ *       query, its query is padded to a multiple of 16 with bases that score
+ *       zero, and it finds the query end through a signed char, all of which
+ *       is copied here. As lanes never mix, the same kernel is built for
+ *       SSE2, AVX2 and AVX-512 and the widest the processor runs is chosen
+ *       by align_batch_init
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <immintrin.h>
+#include "ddradseq.h"
+
+/* Codes of ambiguous bases and of columns past a padded query, which match nothing */
+#define QUERY_N 0x80
+#define QUERY_PAD 0xc0
+#define TARGET_N 0x40
+
+/* Query length rounded up to whole vectors, as local_align lays it out */
+#define PADDED(l) (((l) + 15) / 16 * 16)
+
+/* A kernel aligning the n pairs of a batch that start at pair l0 */
+typedef int (*ALIGN_KERNEL)(ALIGN_BATCH *ab, const int l0, const int n, const int sa,
+                            const int sb, const int gapo, const int gape, ALIGN_WORK *w,
+                            FILE *lf);
+
+/* Function prototypes */
+static int query_end(const unsigned char *hmax, const int width, const int l, const int qlen);
+
+/* SSE2 kernel, which every x86-64 processor runs */
+#define KERNEL align_sse2
+#define KERNEL_TARGET "sse2"
+#define LANES 16
+#define VEC __m128i
+#define VZERO() _mm_setzero_si128()
+#define VSET1(x) _mm_set1_epi8((char)(x))
+#define VLOADU(p) _mm_loadu_si128((const __m128i*)(p))
+#define VSTOREU(p, a) _mm_storeu_si128((__m128i*)(p), (a))
+#define VADDS(a, b) _mm_adds_epu8((a), (b))
+#define VSUBS(a, b) _mm_subs_epu8((a), (b))
+#define VMAX(a, b) _mm_max_epu8((a), (b))
+#define VMIN(a, b) _mm_min_epu8((a), (b))
+#define VAND(a, b) _mm_and_si128((a), (b))
+#define VANDN(a, b) _mm_andnot_si128((a), (b))
+#define VOR(a, b) _mm_or_si128((a), (b))
+#define VCMPEQ(a, b) _mm_cmpeq_epi8((a), (b))
+#define VMASK(a) ((uint64_t)(uint16_t)_mm_movemask_epi8(a))
+#include "align_kernel.h"
+#undef KERNEL
+#undef KERNEL_TARGET
+#undef LANES
+#undef VEC
+#undef VZERO
+#undef VSET1
+#undef VLOADU
+#undef VSTOREU
+#undef VADDS
+#undef VSUBS
+#undef VMAX
+#undef VMIN
+#undef VAND
+#undef VANDN
+#undef VOR
+#undef VCMPEQ
+#undef VMASK
+
+/* AVX2 kernel */
+#define KERNEL align_avx2
+#define KERNEL_TARGET "avx2"
+#define LANES 32
+#define VEC __m256i
+#define VZERO() _mm256_setzero_si256()
+#define VSET1(x) _mm256_set1_epi8((char)(x))
+#define VLOADU(p) _mm256_loadu_si256((const __m256i*)(p))
+#define VSTOREU(p, a) _mm256_storeu_si256((__m256i*)(p), (a))
+#define VADDS(a, b) _mm256_adds_epu8((a), (b))
+#define VSUBS(a, b) _mm256_subs_epu8((a), (b))
+#define VMAX(a, b) _mm256_max_epu8((a), (b))
+#define VMIN(a, b) _mm256_min_epu8((a), (b))
+#define VAND(a, b) _mm256_and_si256((a), (b))
+#define VANDN(a, b) _mm256_andnot_si256((a), (b))
+#define VOR(a, b) _mm256_or_si256((a), (b))
+#define VCMPEQ(a, b) _mm256_cmpeq_epi8((a), (b))
+#define VMASK(a) ((uint64_t)(uint32_t)_mm256_movemask_epi8(a))
+#include "align_kernel.h"
+#undef KERNEL
+#undef KERNEL_TARGET
+#undef LANES
+#undef VEC
+#undef VZERO
+#undef VSET1
+#undef VLOADU
+#undef VSTOREU
+#undef VADDS
+#undef VSUBS
+#undef VMAX
+#undef VMIN
+#undef VAND
+#undef VANDN
+#undef VOR
+#undef VCMPEQ
+#undef VMASK
+
+/* AVX-512 kernel, byte lanes needing the BW extension; comparisons */
+/* are widened back from mask registers so the body stays the same */
+#define KERNEL align_avx512
+#define KERNEL_TARGET "avx512f,avx512bw"
+#define LANES 64
+#define VEC __m512i
+#define VZERO() _mm512_setzero_si512()
+#define VSET1(x) _mm512_set1_epi8((char)(x))
+#define VLOADU(p) _mm512_loadu_si512((const void*)(p))
+#define VSTOREU(p, a) _mm512_storeu_si512((void*)(p), (a))
+#define VADDS(a, b) _mm512_adds_epu8((a), (b))
+#define VSUBS(a, b) _mm512_subs_epu8((a), (b))
+#define VMAX(a, b) _mm512_max_epu8((a), (b))
+#define VMIN(a, b) _mm512_min_epu8((a), (b))
+#define VAND(a, b) _mm512_and_si512((a), (b))
+#define VANDN(a, b) _mm512_andnot_si512((a), (b))
+#define VOR(a, b) _mm512_or_si512((a), (b))
+#define VCMPEQ(a, b) _mm512_movm_epi8(_mm512_cmpeq_epi8_mask((a), (b)))
+#define VMASK(a) ((uint64_t)_mm512_movepi8_mask(a))
+#include "align_kernel.h"
+#undef KERNEL
+#undef KERNEL_TARGET
+#undef LANES
+#undef VEC
+#undef VZERO
+#undef VSET1
+#undef VLOADU
+#undef VSTOREU
+#undef VADDS
+#undef VSUBS
+#undef VMAX
+#undef VMIN
+#undef VAND
+#undef VANDN
+#undef VOR
+#undef VCMPEQ
+#undef VMASK
+
+/* Globally scoped variables */
+static ALIGN_KERNEL kernel = align_sse2;
+static int kernel_lanes = 16;
+
+void align_batch_init(FILE *lf)
+{
+	const char *isa = "SSE2";
+
+	/* Chosen once at startup, before any thread aligns */
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512bw"))
+	{
+		kernel = align_avx512;
+		kernel_lanes = 64;
+		isa = "AVX-512";
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		kernel = align_avx2;
+		kernel_lanes = 32;
+		isa = "AVX2";
+	}
+	loginfo(lf, "Aligning up to %d mate pairs at a time with %s.\n", kernel_lanes, isa);
+}
+
+int align_batch(ALIGN_BATCH *ab, const int sa, const int sb, const int gapo, const int gape,
+                ALIGN_WORK *w, FILE *lf)
+{
+	int l = 0;
+
+	/* A batch wider than the kernel is aligned a vector's worth at a time */
+	for (l = 0; l < ab->n; l += kernel_lanes)
+		if (kernel(ab, l, ab->n - l < kernel_lanes ? ab->n - l : kernel_lanes, sa, sb, gapo,
+		           gape, w, lf))
+			return 1;
+
+	return 0;
+}
+
+static int query_end(const unsigned char *hmax, const int width, const int l, const int qlen)
+{
+	int max = -1;
+	int qe = -1;
+	int i = 0;
+	int k = 0;
+	int pos = 0;
+	int slen = (qlen + 15) / 16;
+
+	/* The first maximum in the striped order local_align scans, padding */
+	/* included and scores above 127 taken as negative just as it does */
+	for (i = 0; i < slen; i++)
+	{
+		for (k = 0, pos = i; k < 16; k++, pos += slen)
+		{
+			if ((signed char)hmax[pos * width + l] > max)
+			{
+				max = (signed char)hmax[pos * width + l];
+				qe = pos;
+			}
+		}
+	}
+
+	return qe;
+}
@@ -0,0 +1,193 @@
+/* file: align_kernel.h
+ * description: Body of the batched Smith-Waterman kernel, included once for each vector width
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ * note: align_batch.c defines KERNEL, KERNEL_TARGET, LANES and the V*()
+ *       vector operations before each inclusion
+ */
+
+static int __attribute__((target(KERNEL_TARGET)))
+KERNEL(ALIGN_BATCH *ab, const int l0, const int n, const int sa, const int sb, const int gapo,
+       const int gape, ALIGN_WORK *w, FILE *lf)
+{
+	char *mem = NULL;
+	unsigned char g[LANES];
+	unsigned char live[LANES];
+	unsigned char want[LANES];
+	unsigned char *b = NULL;
+	int i = 0;
+	int j = 0;
+	int l = 0;
+	int c = 0;
+	int slen = 0;
+	int maxq = 0;
+	int maxt = 0;
+	int nlive = 0;
+	int te[LANES];
+	bool sat[LANES];
+	uint64_t mask = 0;
+	VEC *qv, *qs, *bm, *H, *E, *Hmax, *tv, *ts;
+	VEC h, e, s, t, tr, sh, fb, ff, hd, max, gmax, gt, upd, keep, alive, minsc;
+	const VEC zero = VZERO();
+	const VEC match = VSET1(sa + sb);
+	const VEC gapoe = VSET1(gapo + gape);
+	const VEC vgape = VSET1(gape);
+
+	for (l = 0; l < n; l++)
+	{
+		if (PADDED(ab->qlen[l0 + l]) > maxq)
+			maxq = PADDED(ab->qlen[l0 + l]);
+		if (ab->tlen[l0 + l] > maxt)
+			maxt = ab->tlen[l0 + l];
+	}
+
+	/* Query columns and target rows are laid out one pair to a byte lane */
+	mem = grow_buffer(&w->dp, &w->dp_size, (6 * maxq + 2 * maxt) * sizeof(VEC) + 63u);
+	if (UNLIKELY(!mem))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return 1;
+	}
+	qv = (VEC*)(((size_t)mem + 63u) >> 6 << 6);
+	qs = qv + maxq;
+	bm = qs + maxq;
+	H = bm + maxq;
+	E = H + maxq;
+	Hmax = E + maxq;
+	tv = Hmax + maxq;
+	ts = tv + maxt;
+	memset(qv, QUERY_PAD, maxq * sizeof(VEC));
+	memset(qs, sb, maxq * sizeof(VEC));
+	memset(bm, 0xff, maxq * sizeof(VEC));
+	memset(H, 0, 3 * maxq * sizeof(VEC));
+	memset(tv, TARGET_N, maxt * sizeof(VEC));
+	memset(ts, 0, maxt * sizeof(VEC));
+	memset(live, 0, sizeof(live));
+	memset(want, 0xff, sizeof(want));
+	for (l = 0; l < n; l++)
+	{
+		const int ql = ab->qlen[l0 + l];
+		const int tl = ab->tlen[l0 + l];
+
+		/* Deletions in local_align only carry within a 16th of the query */
+		slen = (ql + 15) / 16;
+		for (b = (unsigned char*)qv + l, j = 0; j < PADDED(ql); j++, b += LANES)
+		{
+			c = j < ql ? ab->query[l0 + l][j] : 4;
+			*b = c < 4 ? c : QUERY_N;
+			b[(qs - qv) * LANES] = c < 4 ? sb : 0;
+			if ((j + 1) % slen == 0)
+				b[(bm - qv) * LANES] = 0;
+		}
+		for (b = (unsigned char*)tv + l, i = 0; i < tl; i++, b += LANES)
+		{
+			c = ab->target[l0 + l][i];
+			*b = c < 4 ? c : TARGET_N;
+			b[(ts - tv) * LANES] = c < 4 ? sb : 0;
+		}
+		if (ab->minsc[l0 + l] < 255)
+			want[l] = ab->minsc[l0 + l] > 0 ? (unsigned char)ab->minsc[l0 + l] : 0;
+		te[l] = -1;
+		sat[l] = false;
+		if (tl > 0)
+		{
+			live[l] = 0xff;
+			nlive++;
+		}
+	}
+
+	/* Each row is one target base against the whole of every query */
+	gmax = zero;
+	minsc = VLOADU(want);
+	alive = VLOADU(live);
+	for (i = 0; i < maxt && nlive > 0; i++)
+	{
+		tr = tv[i];
+		sh = ts[i];
+		fb = zero;
+		ff = zero;
+		hd = zero;
+		max = zero;
+		for (j = 0; LIKELY(j < maxq); j++)
+		{
+			/* H'(i,j) without the deletions begun in earlier 16ths, an N */
+			/* scoring zero by being spared the shift of local_align */
+			s = VAND(VCMPEQ(tr, qv[j]), match);
+			h = VSUBS(VADDS(hd, s), VMIN(qs[j], sh));
+			e = E[j];
+			h = VMAX(h, e);
+			h = VMAX(h, fb);
+
+			/* E(i+1,j) and the deletion within this 16th */
+			t = VSUBS(h, gapoe);
+			E[j] = VMAX(VSUBS(e, vgape), t);
+			fb = VAND(VMAX(VSUBS(fb, vgape), t), bm[j]);
+
+			/* H(i,j) with every deletion */
+			h = VMAX(h, ff);
+			max = VMAX(max, h);
+			hd = H[j];
+			H[j] = h;
+			ff = VMAX(VSUBS(ff, vgape), VSUBS(h, gapoe));
+		}
+
+		/* Keep the row of each pair whose best score went up */
+		gt = VANDN(VCMPEQ(max, gmax), VCMPEQ(VMAX(max, gmax), max));
+		upd = VAND(gt, alive);
+		mask = VMASK(upd);
+		if (mask)
+		{
+			gmax = VOR(VAND(upd, max), VANDN(upd, gmax));
+
+			/* Only rows scoring high enough to want a query end are kept */
+			keep = VAND(upd, VCMPEQ(VMAX(max, minsc), max));
+			if (VMASK(keep))
+				for (j = 0; LIKELY(j < maxq); j++)
+					Hmax[j] = VOR(VAND(keep, H[j]), VANDN(keep, Hmax[j]));
+			VSTOREU(g, gmax);
+			for (l = 0; l < n; l++)
+			{
+				if (!(mask >> l & 1u))
+					continue;
+				te[l] = i;
+				if (g[l] + sb >= 255)
+					sat[l] = true;
+				if (sat[l] || g[l] >= ab->endsc[l0 + l])
+				{
+					live[l] = 0;
+					nlive--;
+				}
+			}
+		}
+
+		/* Retire pairs at the end of their target */
+		for (l = 0; l < n; l++)
+		{
+			if (live[l] && ab->tlen[l0 + l] == i + 1)
+			{
+				live[l] = 0;
+				nlive--;
+			}
+		}
+		alive = VLOADU(live);
+	}
+
+	/* Report each pair as local_align would */
+	VSTOREU(g, gmax);
+	for (l = 0; l < n; l++)
+	{
+		ab->r[l0 + l].score = sat[l] ? 255 : g[l];
+		ab->r[l0 + l].target_begin = -1;
+		ab->r[l0 + l].target_end = te[l];
+		ab->r[l0 + l].query_begin = -1;
+		ab->r[l0 + l].query_end = -1;
+		if (!sat[l] && g[l] >= ab->minsc[l0 + l])
+			ab->r[l0 + l].query_end = query_end((unsigned char*)Hmax, LANES, l, ab->qlen[l0 + l]);
+		ab->r[l0 + l].score2 = -1;
+		ab->r[l0 + l].target_end2 = -1;
+	}
+
+	return 0;
+}
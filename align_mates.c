@@ -9,235 +9,460 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 #include <errno.h>
-#include <zlib.h>
+#include <pthread.h>
 #include "ddradseq.h"
 
-#define NBASES 4
-
-/*Globally scoped variables */
-const char seq_nt4_table[256] = {
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  3, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  3, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4
-};
-const char alpha[5] = "ACGTN";
+/* Number of mate pairs read, aligned and written together */
+#define BATCH_PAIRS (16 * ALIGN_LANES)
+
 extern int errno;
 
-int align_mates(const CMD *cp, const char *forin, const char *revin, const char *forout, const char *revout)
+/* A batch of mate pairs and the order it was read in */
+typedef struct trim_batch_t
+{
+	unsigned long seq;
+	int n;
+	unsigned int count;
+	size_t rlen[BATCH_PAIRS];
+	size_t fcap[BATCH_PAIRS];
+	size_t rcap[BATCH_PAIRS];
+	FASTQ_VIEW *fb[BATCH_PAIRS];
+	FASTQ_VIEW *rb[BATCH_PAIRS];
+} TRIM_BATCH;
+
+/* Arguments shared by the alignment and writer threads of one sample */
+typedef struct trim_worker_t
+{
+	const CMD *cp;
+	BGZF *fout;
+	BGZF *rout;
+	int nbatches;
+	unsigned int count;
+	WORK_QUEUE *full;
+	WORK_QUEUE *done;
+	WORK_QUEUE *empty;
+	atomic_bool failed;
+} TRIM_WORKER;
+
+/* Function prototypes */
+static int align_mates_mt(const CMD *cp, ALIGN_SLOTS *as, FASTQ_READER *fin,
+                          FASTQ_READER *rin, BGZF *fout, BGZF *rout, const char *forin,
+                          const char *revin);
+static int start_aligners(TRIM_WORKER *w, TRIM_BATCH *batches, pthread_t *tid, int *nstarted,
+                          const int n);
+static void *trim_worker(void *arg);
+static void *write_worker(void *arg);
+static int read_batch(TRIM_BATCH *b, FASTQ_READER *fin, FASTQ_READER *rin, const char *forin,
+                      const char *revin, FILE *lf);
+static int trim_batch(const CMD *cp, TRIM_BATCH *b, ALIGN_WORK *aw);
+static void write_batch(const TRIM_BATCH *b, BGZF *fout, BGZF *rout);
+static void free_batch(TRIM_BATCH *b);
+static int hold_mate(FASTQ_VIEW **e, size_t *cap, const FASTQ_VIEW *v);
+
+int align_mates(const CMD *cp, BGZF_POOL *bp, ALIGN_SLOTS *as, const char *forin,
+                const char *revin, const char *forout, const char *revout)
 {
-	char **fbuf = NULL;
-	char **rbuf = NULL;
 	char *errstr = NULL;
-	char mat[25];
-	int i = 0;
-	int j = 0;
-	int k = 0;
-	int xtra = KSW_XSTART;
-	const int sa = 1;
-	const int sb = 3;
-	const int gap_open = cp->gapo;
-	const int gap_extend = cp->gape;
-	const int min_score = cp->score;
+	int ret = 0;
 	unsigned int count = 0;
-	size_t l = 0;
-	size_t lc = 0;
 	FILE *lf = cp->lf;
-	gzFile fin;
-	gzFile rin;
-	gzFile fout;
-	gzFile rout;
+	FASTQ_READER *fin = NULL;
+	FASTQ_READER *rin = NULL;
+	BGZF *fout = NULL;
+	BGZF *rout = NULL;
+	TRIM_BATCH *b = NULL;
+	ALIGN_WORK aw;
 
-	/* Allocate buffer memory from the heap */
-	fbuf = malloc(BSIZE * sizeof(char*));
-	if (UNLIKELY(fbuf == NULL))
-	{
-		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-		return 1;
-	}
-	rbuf = malloc(BSIZE * sizeof(char*));
-	if (UNLIKELY(rbuf == NULL))
-	{
-		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-		return 1;
-	}
-	for (i = 0; i < BSIZE; i++)
-	{
-		fbuf[i] = malloc(MAX_LINE_LENGTH);
-		if (UNLIKELY(!fbuf[i]))
-		{
-			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-			return 1;
-		}
-		rbuf[i] = malloc(MAX_LINE_LENGTH);
-		if (UNLIKELY(!rbuf[i]))
-		{
-			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-			return 1;
-		}
-	}
-
-	/* Open input forward fastQ file stream */
-	fin = gzopen(forin, "rb");
+	/* Open input forward and reverse fastQ file streams */
+	fin = fqreader_open(forin, lf);
 	if (!fin)
-	{
-		errstr = strerror(errno);
-		logerror(lf, "%s:%d Failed to open input forward fastQ file \'%s\': %s.\n",
-		         __func__, __LINE__, forin, errstr);
 		return 1;
-	}
-
-	/* Open input reverse fastQ file stream */
-	rin = gzopen(revin, "rb");
+	rin = fqreader_open(revin, lf);
 	if (!rin)
 	{
-		errstr = strerror(errno);
-		logerror(lf, "%s:%d Failed to open input reverse fastQ file \'%s\': %s.\n",
-		         __func__, __LINE__, revin, errstr);
-		return 1;
+		ret = 1;
+		goto cleanup;
 	}
 
 	/* Open output forward fastQ file stream */
-	fout = gzopen(forout, "wb");
+	fout = bgzf_open(forout, bp, lf);
 	if (!fout)
 	{
+		errstr = strerror(errno);
 		logerror(lf, "%s:%d Failed to open forward output fastQ file \'%s\': %s.\n",
 		         __func__, __LINE__, forout, errstr);
-		return 1;
+		ret = 1;
+		goto cleanup;
 	}
 
 	/* Open output reverse fastQ file stream */
-	rout = gzopen(revout, "wb");
+	rout = bgzf_open(revout, bp, lf);
 	if (!rout)
 	{
 		errstr = strerror(errno);
 		logerror(lf, "%s:%d Failed to open reverse output fastQ file \'%s\': %s.\n",
 		         __func__, __LINE__, revout, errstr);
-		return 1;
+		ret = 1;
+		goto cleanup;
 	}
 
-	/* Initialize the scoring matrix */
-	for (i = k = 0; i < NBASES; i++)
+	/* Batches are aligned on several threads and written back in the order read */
+	if (as && cp->nthreads > 1)
+	{
+		ret = align_mates_mt(cp, as, fin, rin, fout, rout, forin, revin);
+		if (ret)
+			goto cleanup;
+	}
+	else
 	{
-		for (j = 0; j < NBASES; j++)
-			mat[k++] = (i == j) ? sa : -sb;
+		/* A single aligner reads, aligns and writes each batch in turn */
+		b = calloc(1, sizeof(TRIM_BATCH));
+		if (UNLIKELY(!b))
+		{
+			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+			ret = 1;
+			goto cleanup;
+		}
+		memset(&aw, 0, sizeof(ALIGN_WORK));
+		do
+		{
+			ret = read_batch(b, fin, rin, forin, revin, lf) || trim_batch(cp, b, &aw);
+			if (ret)
+				break;
+			write_batch(b, fout, rout);
+			count += b->count;
+		} while (b->n == BATCH_PAIRS);
+
+		/* Print informational message to logfile */
+		if (!ret)
+			loginfo(lf, "%u sequences trimmed.\n", count);
 
-		/* Ambiguous base */
-		mat[k++] = 0;
+		/* Free memory from the heap */
+		free_batch(b);
+		free(b);
+		align_work_free(&aw);
 	}
-	for (j = 0; j <= NBASES; j++)
-		mat[k++] = 0;
 
-	while (1)
+cleanup:
+	/* Close all file streams */
+	fqreader_close(fin);
+	fqreader_close(rin);
+	ret |= bgzf_close(fout);
+	ret |= bgzf_close(rout);
+
+	return ret ? 1 : 0;
+}
+
+static int align_mates_mt(const CMD *cp, ALIGN_SLOTS *as, FASTQ_READER *fin,
+                          FASTQ_READER *rin, BGZF *fout, BGZF *rout, const char *forin,
+                          const char *revin)
+{
+	int ret = 0;
+	int t = 0;
+	int nstarted = 0;
+	int naligners = 0;
+	int nheld = 0;
+	bool writer = false;
+	unsigned long seq = 0;
+	TRIM_BATCH *batches = NULL;
+	TRIM_BATCH *b = NULL;
+	TRIM_WORKER w;
+	pthread_t *tid = NULL;
+	pthread_t wid;
+	FILE *lf = cp->lf;
+
+	/* Take the sample's share of the alignment threads */
+	naligners = align_slots_take(as);
+	nheld = naligners;
+
+	/* Allocate enough batches to keep every aligner the sample may */
+	/* grow to busy while the reader fills the next one and the writer */
+	/* waits on a slow one; each aligner started hands over two of them */
+	w.nbatches = 2 * cp->nthreads + 2;
+	batches = calloc(w.nbatches, sizeof(TRIM_BATCH));
+	tid = malloc(cp->nthreads * sizeof(pthread_t));
+	w.full = queue_init(w.nbatches);
+	w.done = queue_init(w.nbatches);
+	w.empty = queue_init(w.nbatches);
+	atomic_init(&w.failed, false);
+	if (UNLIKELY(!batches || !tid || !w.full || !w.done || !w.empty))
 	{
-		/* Fill up the forward buffer */
-		for (lc = 0; lc < BSIZE; lc++)
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		atomic_store(&w.failed, true);
+		goto cleanup;
+	}
+	queue_push(w.empty, &batches[0]);
+	queue_push(w.empty, &batches[1]);
+
+	/* Start the alignment threads and the writer thread */
+	w.cp = cp;
+	w.fout = fout;
+	w.rout = rout;
+	w.count = 0;
+	if (start_aligners(&w, batches, tid, &nstarted, naligners) == 0)
+	{
+		ret = pthread_create(&wid, NULL, write_worker, &w);
+		if (ret)
 		{
-			/* Clear the buffer */
-			memset(fbuf[lc], 0, MAX_LINE_LENGTH);
+			logerror(lf, "%s:%d Failed to create writer thread: %s.\n", __func__,
+			         __LINE__, strerror(ret));
+			atomic_store(&w.failed, true);
+		}
+		else
+			writer = true;
+	}
 
-			/* Get line from the fastQ input stream */
-			if (gzgets(fin, fbuf[lc], MAX_LINE_LENGTH) == Z_NULL)
+	/* The calling thread reads the mates in lockstep, numbering */
+	/* each batch so the writer can put them back in order */
+	while (!atomic_load(&w.failed) && (b = queue_pop(w.empty)) != NULL)
+	{
+		/* Take on the threads of samples that have finished */
+		if (nstarted < cp->nthreads)
+		{
+			naligners = align_slots_grow(as, cp->nthreads - nstarted);
+			nheld += naligners;
+			if (start_aligners(&w, batches, tid, &nstarted, naligners))
 				break;
 		}
+		if (read_batch(b, fin, rin, forin, revin, lf))
+		{
+			atomic_store(&w.failed, true);
+			break;
+		}
+		b->seq = seq++;
+		queue_push(w.full, b);
+		if (b->n < BATCH_PAIRS)
+			break;
+	}
+
+	/* Wait for the aligners, then for the writer, to drain their queues; */
+	/* without a writer the done queue is never popped, but it holds every batch */
+	queue_close(w.full);
+	for (t = 0; t < nstarted; t++)
+		pthread_join(tid[t], NULL);
+	queue_close(w.done);
+	if (writer)
+		pthread_join(wid, NULL);
+
+	/* Print informational message to logfile */
+	if (!atomic_load(&w.failed))
+		loginfo(lf, "%u sequences trimmed.\n", w.count);
+
+cleanup:
+	/* Hand the alignment threads on to the samples still running */
+	align_slots_release(as, nheld);
+
+	/* Free memory from the heap */
+	if (batches)
+	{
+		for (t = 0; t < w.nbatches; t++)
+			free_batch(&batches[t]);
+	}
+	free(batches);
+	free(tid);
+	queue_destroy(w.full);
+	queue_destroy(w.done);
+	queue_destroy(w.empty);
+
+	return atomic_load(&w.failed) ? 1 : 0;
+}
+
+static int start_aligners(TRIM_WORKER *w, TRIM_BATCH *batches, pthread_t *tid, int *nstarted,
+                          const int n)
+{
+	int ret = 0;
+	int t = 0;
 
-		/* Fill up the reverse buffer */
-		for (lc = 0; lc < BSIZE; lc++)
+	for (t = 0; t < n; t++)
+	{
+		queue_push(w->empty, &batches[2 * *nstarted + 2]);
+		queue_push(w->empty, &batches[2 * *nstarted + 3]);
+		ret = pthread_create(&tid[*nstarted], NULL, trim_worker, w);
+		if (ret)
 		{
-			/* Clear the buffer */
-			memset(rbuf[lc], 0, MAX_LINE_LENGTH);
+			logerror(w->cp->lf, "%s:%d Failed to create alignment thread: %s.\n", __func__,
+			         __LINE__, strerror(ret));
+			atomic_store(&w->failed, true);
+			return 1;
+		}
+		(*nstarted)++;
+	}
 
-			/* Get line from the fastQ input stream */
-			if (gzgets(rin, rbuf[lc], MAX_LINE_LENGTH) == Z_NULL)
-				break;
+	return 0;
+}
+
+static void *trim_worker(void *arg)
+{
+	TRIM_WORKER *w = (TRIM_WORKER*)arg;
+	TRIM_BATCH *b = NULL;
+	ALIGN_WORK aw;
+
+	/* Each thread keeps its alignment buffers */
+	memset(&aw, 0, sizeof(ALIGN_WORK));
+
+	while ((b = queue_pop(w->full)) != NULL)
+	{
+		/* Keep draining the queue after a failure so the reader never blocks */
+		if (!atomic_load(&w->failed) && trim_batch(w->cp, b, &aw))
+			atomic_store(&w->failed, true);
+		queue_push(w->done, b);
+	}
+	align_work_free(&aw);
+
+	return NULL;
+}
+
+static void *write_worker(void *arg)
+{
+	int i = 0;
+	unsigned long next = 0;
+	TRIM_WORKER *w = (TRIM_WORKER*)arg;
+	TRIM_BATCH *b = NULL;
+	TRIM_BATCH **slot = NULL;
+
+	/* No more batches than there are slots are ever in flight, */
+	/* so each one waiting its turn has a slot of its own */
+	slot = calloc(w->nbatches, sizeof(TRIM_BATCH*));
+	if (UNLIKELY(!slot))
+	{
+		logerror(w->cp->lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		atomic_store(&w->failed, true);
+	}
+
+	while ((b = queue_pop(w->done)) != NULL)
+	{
+		/* Hand batches back untouched after a failure so the reader never blocks */
+		if (atomic_load(&w->failed))
+		{
+			queue_push(w->empty, b);
+			continue;
 		}
 
-		/* Iterate through lines in the buffers */
-		for (l = 0; l < lc; l++)
+		/* Write out every batch that is next in line */
+		slot[b->seq % w->nbatches] = b;
+		i = (int)(next % w->nbatches);
+		while (slot[i] != NULL)
 		{
-			/* We are at the end of one fastQ entry */
-			if (l % 4 == 3)
-			{
-				ALIGN_RESULT r;
-				char *target = NULL;
-				char *query = NULL;
-				target = strdup(&fbuf[l-2][0]);
-				query = revcom(&rbuf[l-2][0], lf);
-				if (!target || !query)
-					return 1;
-				int tlen = (int)strlen(target);
-				target[tlen] = '\0';
-				int qlen = (int)strlen(query);
-
-				/* Transform sequences */
-				for (i = 0; i < qlen; i++)
-					query[i] = seq_nt4_table[(unsigned char)query[i]];
-				for (i = 0; i < tlen; i++)
-					target[i] = seq_nt4_table[(unsigned char)target[i]];
-
-				/* Do the alignment */
-				r = local_align(qlen, query, tlen, target, mat, gap_open, gap_extend, xtra, lf);
-				free(target);
-				free(query);
-
-				/* Actually trim the sequence */
-				if (r.score >= min_score)
-				{
-					/* Test trimming criterion */
-					if (r.target_begin == 0 && r.query_begin > 0)
-					{
-						int new_end_pos = qlen - r.query_begin;
-						char *seq = &rbuf[l-2][0];
-						char *qual = &rbuf[l][0];
-						seq[new_end_pos] = '\n';
-						seq[new_end_pos+1] = '\0';
-						qual[new_end_pos] = '\n';
-						qual[new_end_pos+1] = '\0';
-						count++;
-					}
-				}
-
-				/* Write sequences to file */
-				gzprintf(fout, "%s%s+\n%s", &fbuf[l-3][0], &fbuf[l-2][0], &fbuf[l][0]);
-				gzprintf(rout, "%s%s+\n%s", &rbuf[l-3][0], &rbuf[l-2][0], &rbuf[l][0]);
-			}
+			write_batch(slot[i], w->fout, w->rout);
+			w->count += slot[i]->count;
+			queue_push(w->empty, slot[i]);
+			slot[i] = NULL;
+			i = (int)(++next % w->nbatches);
 		}
+	}
+	free(slot);
 
-		/* If we are at the end of the file */
-		if (lc < BSIZE)
-			break;
+	return NULL;
+}
+
+static int read_batch(TRIM_BATCH *b, FASTQ_READER *fin, FASTQ_READER *rin, const char *forin,
+                      const char *revin, FILE *lf)
+{
+	int fret = 0;
+	int rret = 0;
+	FASTQ_VIEW fv;
+	FASTQ_VIEW rv;
+
+	/* Read the mates in lockstep */
+	b->n = 0;
+	while (b->n < BATCH_PAIRS && (fret = fqreader_next(fin, &fv)) > 0 &&
+	       (rret = fqreader_next(rin, &rv)) > 0)
+	{
+		if (hold_mate(&b->fb[b->n], &b->fcap[b->n], &fv) ||
+		    hold_mate(&b->rb[b->n], &b->rcap[b->n], &rv))
+		{
+			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+			return 1;
+		}
+		b->n++;
 	}
+	if (b->n == BATCH_PAIRS)
+		return 0;
 
-	/* Print informational message to logfile */
-	loginfo(lf, "%u sequences trimmed.\n", count);
+	/* Both files must end together */
+	if (fret == 0)
+		rret = fqreader_next(rin, &rv);
+	if (fret < 0 || rret < 0)
+		return 1;
+	if (fret > 0 || rret > 0)
+	{
+		logerror(lf, "%s:%d Files \'%s\' and \'%s\' hold different numbers of fastQ entries.\n",
+		         __func__, __LINE__, forin, revin);
+		return 1;
+	}
 
-	/* Free memory from the heap */
-	for (i = 0; i < BSIZE; i++)
+	return 0;
+}
+
+static int trim_batch(const CMD *cp, TRIM_BATCH *b, ALIGN_WORK *aw)
+{
+	int k = 0;
+	int n = 0;
+
+	/* Align the mates to find the 3' end of each reverse sequence */
+	for (k = 0; k < b->n; k += ALIGN_LANES)
 	{
-		free(fbuf[i]);
-		free(rbuf[i]);
+		n = b->n - k < ALIGN_LANES ? b->n - k : ALIGN_LANES;
+		if (trim_mates(cp, &b->fb[k], &b->rb[k], n, &b->rlen[k], aw))
+			return 1;
 	}
-	free(fbuf);
-	free(rbuf);
 
-	/* Close all file streams */
-	gzclose(fin);
-	gzclose(rin);
-	gzclose(fout);
-	gzclose(rout);
+	/* Actually trim the sequences */
+	b->count = 0;
+	for (k = 0; k < b->n; k++)
+	{
+		if (b->rlen[k] < b->rb[k]->seq_len)
+		{
+			b->rb[k]->seq_len = b->rlen[k];
+			if (b->rlen[k] < b->rb[k]->qual_len)
+				b->rb[k]->qual_len = b->rlen[k];
+			b->count++;
+		}
+	}
+
+	return 0;
+}
+
+static void write_batch(const TRIM_BATCH *b, BGZF *fout, BGZF *rout)
+{
+	int k = 0;
+
+	/* Write sequences to file */
+	for (k = 0; k < b->n; k++)
+	{
+		bgzf_write_fastq(fout, b->fb[k]);
+		bgzf_write_fastq(rout, b->rb[k]);
+	}
+}
+
+static void free_batch(TRIM_BATCH *b)
+{
+	int k = 0;
+
+	for (k = 0; k < BATCH_PAIRS; k++)
+	{
+		free(b->fb[k]);
+		free(b->rb[k]);
+	}
+}
+
+static int hold_mate(FASTQ_VIEW **e, size_t *cap, const FASTQ_VIEW *v)
+{
+	void *tmp = NULL;
+
+	/* Entries are copied out, as the reader reuses its buffer */
+	if (FASTQ_SIZE(v) > *cap)
+	{
+		tmp = realloc(*e, FASTQ_SIZE(v));
+		if (UNLIKELY(!tmp))
+			return 1;
+		*e = tmp;
+		*cap = FASTQ_SIZE(v);
+	}
+	copy_fastq(*e, v);
 
 	return 0;
 }
@@ -0,0 +1,77 @@
+/* file: align_slots.c
+ * description: Budget of alignment threads shared by the samples trimmed at once
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include "ddradseq.h"
+
+ALIGN_SLOTS *align_slots_init(const int nslots, const int nsamples, const int nworkers)
+{
+	ALIGN_SLOTS *as = NULL;
+
+	as = malloc(sizeof(ALIGN_SLOTS));
+	if (UNLIKELY(!as))
+		return NULL;
+	as->nfree = nslots;
+	as->npending = nsamples;
+	as->share = nslots / (nworkers > 0 ? nworkers : 1);
+	if (as->share < 1)
+		as->share = 1;
+	pthread_mutex_init(&as->lock, NULL);
+
+	return as;
+}
+
+int align_slots_take(ALIGN_SLOTS *as)
+{
+	int n = 0;
+
+	/* Until every sample has started, the slots are split evenly, */
+	/* so a sample starting never finds its share taken */
+	pthread_mutex_lock(&as->lock);
+	as->npending--;
+	n = as->share < as->nfree ? as->share : as->nfree;
+	if (n < 1)
+		n = 1;
+	as->nfree -= n;
+	pthread_mutex_unlock(&as->lock);
+
+	return n;
+}
+
+int align_slots_grow(ALIGN_SLOTS *as, const int max)
+{
+	int n = 0;
+
+	/* Slots freed by finished samples only go to the samples still */
+	/* running once there are none left to start */
+	pthread_mutex_lock(&as->lock);
+	if (as->npending <= 0 && as->nfree > 0)
+	{
+		n = as->nfree < max ? as->nfree : max;
+		as->nfree -= n;
+	}
+	pthread_mutex_unlock(&as->lock);
+
+	return n;
+}
+
+void align_slots_release(ALIGN_SLOTS *as, const int n)
+{
+	pthread_mutex_lock(&as->lock);
+	as->nfree += n;
+	pthread_mutex_unlock(&as->lock);
+}
+
+void align_slots_destroy(ALIGN_SLOTS *as)
+{
+	if (!as)
+		return;
+	pthread_mutex_destroy(&as->lock);
+	free(as);
+}
@@ -0,0 +1,44 @@
+/* file: align_work.c
+ * description: Buffers for aligning mates, kept by each thread from one pair to the next
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "ddradseq.h"
+
+void *grow_buffer(void **p, size_t *size, const size_t need)
+{
+	void *tmp = NULL;
+
+	/* Buffers only grow, so the longest reads seen set their size */
+	if (need > *size)
+	{
+		tmp = realloc(*p, need);
+		if (UNLIKELY(!tmp))
+			return NULL;
+		*p = tmp;
+		*size = need;
+	}
+
+	return *p;
+}
+
+void align_work_free(ALIGN_WORK *w)
+{
+	free(w->prof);
+	free(w->dp);
+	free(w->b);
+	free(w->seq);
+	w->prof = NULL;
+	w->dp = NULL;
+	w->b = NULL;
+	w->seq = NULL;
+	w->prof_size = 0;
+	w->dp_size = 0;
+	w->b_size = 0;
+	w->seq_size = 0;
+}
@@ -0,0 +1,55 @@
+/* file: append_fastq.c
+ * description: Copies a fastQ entry into an output buffer or into memory where it is held
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <string.h>
+#include "ddradseq.h"
+
+size_t append_fastq(char *buff, const FASTQ_VIEW *v, const size_t trim)
+{
+	char *p = buff;
+	const size_t sl = v->seq_len - trim;
+	const size_t ql = v->qual_len - trim;
+
+	memcpy(p, v->id, v->id_len);
+	p += v->id_len;
+	*p++ = '\n';
+	memcpy(p, v->seq + trim, sl);
+	p += sl;
+	*p++ = '\n';
+	*p++ = '+';
+	*p++ = '\n';
+	memcpy(p, v->qual + trim, ql);
+	p += ql;
+	*p++ = '\n';
+
+	return (size_t)(p - buff);
+}
+
+FASTQ_VIEW *copy_fastq(void *mem, const FASTQ_VIEW *v)
+{
+	FASTQ_VIEW *e = mem;
+	char *p = (char*)(e + 1);
+
+	/* The lines follow the view, each null-terminated */
+	memcpy(p, v->id, v->id_len);
+	p[v->id_len] = '\0';
+	e->id = p;
+	e->id_len = v->id_len;
+	p += v->id_len + 1u;
+	memcpy(p, v->seq, v->seq_len);
+	p[v->seq_len] = '\0';
+	e->seq = p;
+	e->seq_len = v->seq_len;
+	p += v->seq_len + 1u;
+	memcpy(p, v->qual, v->qual_len);
+	p[v->qual_len] = '\0';
+	e->qual = p;
+	e->qual_len = v->qual_len;
+
+	return e;
+}
@@ -0,0 +1,70 @@
+/* file: arena.c
+ * description: Bump-pointer arena for records freed all at once
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "ddradseq.h"
+
+ARENA *arena_init(void)
+{
+	ARENA *ar = NULL;
+
+	ar = malloc(sizeof(ARENA));
+	if (UNLIKELY(!ar))
+		return NULL;
+	ar->head = NULL;
+	ar->size = 0;
+	ar->used = 0;
+
+	return ar;
+}
+
+void *arena_alloc(ARENA *ar, size_t len)
+{
+	size_t bsize = ARENA_BLOCK_SIZE;
+	ARENA_BLOCK *ab = ar->head;
+	void *p = NULL;
+
+	/* Keep every record aligned for the structures stored in it */
+	len = (len + sizeof(void*) - 1u) & ~(sizeof(void*) - 1u);
+
+	if (!ab || ab->used + len > ab->cap)
+	{
+		/* Records larger than a block get a block of their own */
+		if (len > bsize)
+			bsize = len;
+		ab = malloc(sizeof(ARENA_BLOCK) + bsize);
+		if (UNLIKELY(!ab))
+			return NULL;
+		ab->cap = bsize;
+		ab->used = 0;
+		ab->next = ar->head;
+		ar->head = ab;
+		ar->size += sizeof(ARENA_BLOCK) + bsize;
+	}
+	p = ab->data + ab->used;
+	ab->used += len;
+	ar->used += len;
+
+	return p;
+}
+
+void arena_destroy(ARENA *ar)
+{
+	ARENA_BLOCK *ab = NULL;
+
+	if (!ar)
+		return;
+	while (ar->head)
+	{
+		ab = ar->head;
+		ar->head = ab->next;
+		free(ab);
+	}
+	free(ar);
+}
@@ -0,0 +1,93 @@
+/* file: batch_init.c
+ * description: Lays out a pool's barcodes as bit-vector match masks
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <emmintrin.h>
+#include "khash.h"
+#include "ddradseq.h"
+
+BARCODE_BATCH *batch_init(const POOL *pl, FILE *lf)
+{
+	uint16_t lane[BATCH_LANES];
+	const char *key = NULL;
+	int n = 0;
+	int v = 0;
+	int l = 0;
+	int row = 0;
+	int nrows = 1;
+	size_t i = 0;
+	size_t bl = pl->barcode_length;
+	khint_t k = 0;
+	khash_t(barcode) *b = pl->b;
+	BARCODE_BATCH *bb = NULL;
+
+	bb = calloc(1, sizeof(BARCODE_BATCH));
+	if (UNLIKELY(!bb))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return NULL;
+	}
+	bb->nbc = kh_size(b);
+	bb->nvec = (bb->nbc + BATCH_LANES - 1) / BATCH_LANES;
+	bb->length = bl;
+	bb->bc = malloc(bb->nbc * sizeof(BARCODE*));
+	bb->bkey = malloc(bb->nbc * sizeof(char*));
+	if (UNLIKELY(!bb->bc || !bb->bkey))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return NULL;
+	}
+
+	/* Give each character found in any barcode its own row of masks */
+	for (k = kh_begin(b); k != kh_end(b); k++)
+	{
+		if (kh_exist(b, k))
+		{
+			key = kh_key(b, k);
+			bb->bc[n] = kh_value(b, k);
+			bb->bkey[n++] = key;
+			for (i = 0; i < bl; i++)
+				if (!bb->code[(unsigned char)key[i]])
+					bb->code[(unsigned char)key[i]] = nrows++;
+		}
+	}
+
+	/* Lanes are 16 bits wide; longer barcodes are scored one at a time */
+	if (bl > 16u)
+		return bb;
+
+	bb->mem = malloc(nrows * bb->nvec * sizeof(__m128i) + 15u);
+	if (UNLIKELY(!bb->mem))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return NULL;
+	}
+	bb->peq = (__m128i*)(((size_t)bb->mem + 15) >> 4 << 4);
+
+	/* Row zero matches nothing */
+	for (row = 0; row < nrows; row++)
+	{
+		for (v = 0; v < bb->nvec; v++)
+		{
+			memset(lane, 0, sizeof(lane));
+			for (l = 0; l < BATCH_LANES && v * BATCH_LANES + l < bb->nbc; l++)
+			{
+				key = bb->bkey[v * BATCH_LANES + l];
+				for (i = 0; i < bl; i++)
+					if (bb->code[(unsigned char)key[i]] == row && row > 0)
+						lane[l] |= (uint16_t)(1u << i);
+			}
+			bb->peq[row * bb->nvec + v] = _mm_loadu_si128((__m128i*)lane);
+		}
+	}
+
+	return bb;
+}
@@ -0,0 +1,451 @@
+/* file: bgzf.c
+ * description: Writes fastQ output as BGZF blocks deflated on a pool of threads
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ * note: Every block is a complete gzip member, so the output stays readable by
+ *       any gzip tool while allowing random access at block boundaries
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "ddradseq.h"
+
+#define BGZF_HEADER_SIZE 18
+#define BGZF_FOOTER_SIZE 8
+
+/* Fewest blocks a pooled writer keeps in flight */
+#define BGZF_MIN_RING 4
+
+/* States of a block in a writer's ring */
+#define JOB_FILLING 0
+#define JOB_QUEUED 1
+#define JOB_DONE 2
+#define JOB_FAILED 3
+
+/* Gzip member header with the BC extra field holding the block size */
+static const unsigned char bgzf_header[BGZF_HEADER_SIZE] = {
+	0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
+	0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x00, 0x00
+};
+
+/* Empty block marking the end of the file */
+static const unsigned char bgzf_eof[28] = {
+	0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
+	0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/* Function prototypes */
+static void *bgzf_worker(void *arg);
+static int bgzf_submit(BGZF *fp);
+static int bgzf_drain(BGZF *fp, const int max_pending);
+static int deflate_block(z_stream *zs, BGZF_JOB *job);
+static int write_all(const int fd, const unsigned char *buf, size_t len);
+
+BGZF_POOL *bgzf_pool_init(const int nthreads, const int nwriters, FILE *lf)
+{
+	int t = 0;
+	int ret = 0;
+	BGZF_POOL *bp = NULL;
+
+	bp = malloc(sizeof(BGZF_POOL));
+	if (UNLIKELY(!bp))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return NULL;
+	}
+	bp->nthreads = 0;
+
+	/* The writers open at once share two blocks in flight per thread, */
+	/* so ring memory grows with the threads rather than their square */
+	bp->nring = 2 * nthreads / (nwriters > 0 ? nwriters : 1);
+	if (bp->nring < BGZF_MIN_RING)
+		bp->nring = BGZF_MIN_RING;
+	bp->jobs = queue_init(4 * nthreads);
+	bp->tid = malloc(nthreads * sizeof(pthread_t));
+	if (UNLIKELY(!bp->jobs || !bp->tid))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return NULL;
+	}
+
+	/* Start the compression threads */
+	for (t = 0; t < nthreads; t++)
+	{
+		ret = pthread_create(&bp->tid[t], NULL, bgzf_worker, bp);
+		if (ret)
+		{
+			logerror(lf, "%s:%d Failed to create compression thread: %s.\n", __func__,
+			         __LINE__, strerror(ret));
+			bgzf_pool_destroy(bp);
+			return NULL;
+		}
+		bp->nthreads++;
+	}
+
+	return bp;
+}
+
+void bgzf_pool_destroy(BGZF_POOL *bp)
+{
+	int t = 0;
+
+	if (!bp)
+		return;
+	queue_close(bp->jobs);
+	for (t = 0; t < bp->nthreads; t++)
+		pthread_join(bp->tid[t], NULL);
+	queue_destroy(bp->jobs);
+	free(bp->tid);
+	free(bp);
+}
+
+BGZF *bgzf_open(const char *filename, BGZF_POOL *bp, FILE *lf)
+{
+	int fd = 0;
+	BGZF *fp = NULL;
+
+	fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0)
+		return NULL;
+	fp = bgzf_dopen(fd, filename, bp, lf);
+	if (!fp)
+		close(fd);
+
+	return fp;
+}
+
+BGZF *bgzf_dopen(const int fd, const char *filename, BGZF_POOL *bp, FILE *lf)
+{
+	int i = 0;
+	BGZF *fp = NULL;
+
+	fp = malloc(sizeof(BGZF));
+	if (UNLIKELY(!fp))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* Without a pool every block is compressed as soon as it fills */
+	fp->nring = bp ? bp->nring : 1;
+	fp->ring = calloc(fp->nring, sizeof(BGZF_JOB));
+	if (UNLIKELY(!fp->ring))
+		goto nomem;
+	for (i = 0; i < fp->nring; i++)
+	{
+		fp->ring[i].fp = fp;
+		fp->ring[i].ubuf = malloc(BGZF_BLOCK_SIZE);
+		fp->ring[i].cbuf = malloc(BGZF_MAX_BLOCK_SIZE);
+		if (UNLIKELY(!fp->ring[i].ubuf || !fp->ring[i].cbuf))
+			goto nomem;
+	}
+	fp->fd = fd;
+	fp->filename = filename;
+	fp->pool = bp;
+	fp->head = 0;
+	fp->npending = 0;
+	fp->failed = false;
+	fp->lf = lf;
+	pthread_mutex_init(&fp->lock, NULL);
+	pthread_cond_init(&fp->done, NULL);
+
+	return fp;
+
+nomem:
+	logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+	if (fp->ring)
+	{
+		for (i = 0; i < fp->nring; i++)
+		{
+			free(fp->ring[i].ubuf);
+			free(fp->ring[i].cbuf);
+		}
+		free(fp->ring);
+	}
+	free(fp);
+	errno = ENOMEM;
+	return NULL;
+}
+
+int bgzf_write(BGZF *fp, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	size_t n = 0;
+	BGZF_JOB *job = NULL;
+
+	while (len > 0)
+	{
+		job = &fp->ring[(fp->head + fp->npending) % fp->nring];
+		n = BGZF_BLOCK_SIZE - job->ulen;
+		if (n > len)
+			n = len;
+		memcpy(job->ubuf + job->ulen, p, n);
+		job->ulen += n;
+		p += n;
+		len -= n;
+		if (job->ulen == BGZF_BLOCK_SIZE && bgzf_submit(fp))
+			return 1;
+	}
+
+	return fp->failed;
+}
+
+int bgzf_write_fastq(BGZF *fp, const FASTQ_VIEW *v)
+{
+	size_t len = v->id_len + v->seq_len + v->qual_len + 5u;
+	BGZF_JOB *job = NULL;
+
+	/* Copy straight into the current block when the entry fits */
+	job = &fp->ring[(fp->head + fp->npending) % fp->nring];
+	if (len <= BGZF_BLOCK_SIZE - job->ulen)
+	{
+		job->ulen += append_fastq((char*)job->ubuf + job->ulen, v, 0);
+		return fp->failed;
+	}
+
+	/* Otherwise let the entry span the block boundary */
+	if (bgzf_write(fp, v->id, v->id_len) || bgzf_write(fp, "\n", 1u) ||
+	    bgzf_write(fp, v->seq, v->seq_len) || bgzf_write(fp, "\n+\n", 3u) ||
+	    bgzf_write(fp, v->qual, v->qual_len) || bgzf_write(fp, "\n", 1u))
+		return 1;
+
+	return 0;
+}
+
+int bgzf_flush(BGZF *fp)
+{
+	int ret = 0;
+	BGZF_JOB *job = NULL;
+
+	job = &fp->ring[(fp->head + fp->npending) % fp->nring];
+	if (job->ulen > 0)
+		ret = bgzf_submit(fp);
+	if (bgzf_drain(fp, 0))
+		ret = 1;
+
+	return ret || fp->failed;
+}
+
+int bgzf_close(BGZF *fp)
+{
+	int i = 0;
+	int ret = 0;
+
+	if (!fp)
+		return 0;
+
+	/* Write out every pending block before the end-of-file marker */
+	ret = bgzf_flush(fp);
+	if (!ret && write_all(fp->fd, bgzf_eof, sizeof(bgzf_eof)))
+	{
+		logerror(fp->lf, "%s:%d Problem writing to output file \'%s\': %s.\n", __func__,
+		         __LINE__, fp->filename, strerror(errno));
+		ret = 1;
+	}
+	if (close(fp->fd))
+	{
+		logerror(fp->lf, "%s:%d Problem closing output file \'%s\': %s.\n", __func__,
+		         __LINE__, fp->filename, strerror(errno));
+		ret = 1;
+	}
+
+	/* Free memory from the heap */
+	for (i = 0; i < fp->nring; i++)
+	{
+		free(fp->ring[i].ubuf);
+		free(fp->ring[i].cbuf);
+	}
+	free(fp->ring);
+	pthread_mutex_destroy(&fp->lock);
+	pthread_cond_destroy(&fp->done);
+	free(fp);
+
+	return ret;
+}
+
+static void *bgzf_worker(void *arg)
+{
+	int ok = 0;
+	int ret = 0;
+	z_stream zs;
+	BGZF_POOL *bp = (BGZF_POOL*)arg;
+	BGZF_JOB *job = NULL;
+
+	/* Each thread reuses one deflate stream for all of its blocks */
+	memset(&zs, 0, sizeof(z_stream));
+	ok = deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+	                  Z_DEFAULT_STRATEGY) == Z_OK;
+
+	while ((job = queue_pop(bp->jobs)) != NULL)
+	{
+		ret = ok ? deflate_block(&zs, job) : 1;
+		pthread_mutex_lock(&job->fp->lock);
+		job->status = ret ? JOB_FAILED : JOB_DONE;
+		pthread_cond_broadcast(&job->fp->done);
+		pthread_mutex_unlock(&job->fp->lock);
+	}
+
+	if (ok)
+		deflateEnd(&zs);
+
+	return NULL;
+}
+
+static int bgzf_submit(BGZF *fp)
+{
+	int ret = 0;
+	z_stream zs;
+	BGZF_JOB *job = NULL;
+
+	job = &fp->ring[(fp->head + fp->npending) % fp->nring];
+
+	/* Compress in the calling thread when there is no pool */
+	if (!fp->pool)
+	{
+		memset(&zs, 0, sizeof(z_stream));
+		if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+		                 Z_DEFAULT_STRATEGY) != Z_OK)
+			ret = 1;
+		else
+		{
+			ret = deflate_block(&zs, job);
+			deflateEnd(&zs);
+		}
+		if (ret)
+			logerror(fp->lf, "%s:%d Failed to compress block for output file \'%s\'.\n",
+			         __func__, __LINE__, fp->filename);
+		else if (write_all(fp->fd, job->cbuf, job->clen))
+		{
+			logerror(fp->lf, "%s:%d Problem writing to output file \'%s\': %s.\n",
+			         __func__, __LINE__, fp->filename, strerror(errno));
+			ret = 1;
+		}
+		job->ulen = 0;
+		if (ret)
+			fp->failed = true;
+		return ret;
+	}
+
+	job->status = JOB_QUEUED;
+	fp->npending++;
+	if (queue_push(fp->pool->jobs, job))
+	{
+		logerror(fp->lf, "%s:%d Compression pool has been shut down.\n", __func__, __LINE__);
+		fp->npending--;
+		job->status = JOB_FILLING;
+		fp->failed = true;
+		return 1;
+	}
+
+	/* Keep one block free to fill */
+	return bgzf_drain(fp, fp->nring - 1);
+}
+
+static int bgzf_drain(BGZF *fp, const int max_pending)
+{
+	int status = 0;
+	BGZF_JOB *job = NULL;
+
+	/* Blocks are written in the order they were filled */
+	while (fp->npending > 0)
+	{
+		job = &fp->ring[fp->head];
+		pthread_mutex_lock(&fp->lock);
+		while (job->status == JOB_QUEUED && fp->npending > max_pending)
+			pthread_cond_wait(&fp->done, &fp->lock);
+		status = job->status;
+		pthread_mutex_unlock(&fp->lock);
+		if (status == JOB_QUEUED)
+			break;
+
+		if (status == JOB_FAILED)
+		{
+			if (!fp->failed)
+				logerror(fp->lf, "%s:%d Failed to compress block for output file \'%s\'.\n",
+				         __func__, __LINE__, fp->filename);
+			fp->failed = true;
+		}
+		else if (!fp->failed && write_all(fp->fd, job->cbuf, job->clen))
+		{
+			logerror(fp->lf, "%s:%d Problem writing to output file \'%s\': %s.\n",
+			         __func__, __LINE__, fp->filename, strerror(errno));
+			fp->failed = true;
+		}
+		job->ulen = 0;
+		job->status = JOB_FILLING;
+		fp->head = (fp->head + 1) % fp->nring;
+		fp->npending--;
+	}
+
+	return fp->failed;
+}
+
+static int deflate_block(z_stream *zs, BGZF_JOB *job)
+{
+	size_t clen = 0;
+	uLong crc = 0;
+	unsigned char *p = NULL;
+
+	if (deflateReset(zs) != Z_OK)
+		return 1;
+	zs->next_in = job->ubuf;
+	zs->avail_in = (uInt)job->ulen;
+	zs->next_out = job->cbuf + BGZF_HEADER_SIZE;
+	zs->avail_out = BGZF_MAX_BLOCK_SIZE - BGZF_HEADER_SIZE - BGZF_FOOTER_SIZE;
+	if (deflate(zs, Z_FINISH) != Z_STREAM_END)
+		return 1;
+	clen = BGZF_HEADER_SIZE + zs->total_out + BGZF_FOOTER_SIZE;
+
+	/* Header with the total block size less one */
+	memcpy(job->cbuf, bgzf_header, BGZF_HEADER_SIZE);
+	job->cbuf[16] = (unsigned char)((clen - 1u) & 0xff);
+	job->cbuf[17] = (unsigned char)((clen - 1u) >> 8);
+
+	/* Footer with the checksum and length of the uncompressed data */
+	crc = crc32(0L, job->ubuf, (uInt)job->ulen);
+	p = job->cbuf + clen - BGZF_FOOTER_SIZE;
+	p[0] = (unsigned char)(crc & 0xff);
+	p[1] = (unsigned char)((crc >> 8) & 0xff);
+	p[2] = (unsigned char)((crc >> 16) & 0xff);
+	p[3] = (unsigned char)((crc >> 24) & 0xff);
+	p[4] = (unsigned char)(job->ulen & 0xff);
+	p[5] = (unsigned char)((job->ulen >> 8) & 0xff);
+	p[6] = 0;
+	p[7] = 0;
+	job->clen = clen;
+
+	return 0;
+}
+
+static int write_all(const int fd, const unsigned char *buf, size_t len)
+{
+	ssize_t n = 0;
+
+	while (len > 0)
+	{
+		n = write(fd, buf, len);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return 1;
+		}
+		buf += n;
+		len -= (size_t)n;
+	}
+
+	return 0;
+}
@@ -0,0 +1,397 @@
+/* file: block_reader.c
+ * description: Reads blocks of whole fastQ entries from one file or from two mate-pair files in lockstep,
+ *              and hands out single entries from large decompressed blocks
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <zlib.h>
+#include <errno.h>
+#include "ddradseq.h"
+
+extern int errno;
+
+/* Function prototypes */
+static int fill_buffer(gzFile in, char *buff, const char *carry, const size_t carry_len, size_t *len);
+static size_t save_carry(char *carry, char *buff, size_t nl);
+static FASTQ_READER *fqreader_init(gzFile in, const char *filename, const size_t size, FILE *lf);
+static int fill_views(FASTQ_READER *fr);
+static int index_views(FASTQ_READER *fr);
+
+BLOCK_READER *reader_open(const char *ffor, const char *frev, FILE *lf)
+{
+	char *errstr = NULL;
+	BLOCK_READER *rd = NULL;
+
+	rd = calloc(1, sizeof(BLOCK_READER));
+	if (UNLIKELY(!rd))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return NULL;
+	}
+	rd->ffor = ffor;
+	rd->frev = frev;
+
+	/* Open forward input file */
+	rd->fin = gzopen(ffor, "rb");
+	if (!rd->fin)
+	{
+		errstr = strerror(errno);
+		logerror(lf, "%s:%d Unable to open file \'%s\': %s.\n", __func__, __LINE__,
+		         ffor, errstr);
+		return NULL;
+	}
+	rd->carry = malloc(BUFLEN);
+	if (UNLIKELY(!rd->carry))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return NULL;
+	}
+
+	/* Open reverse input file when reading mates in lockstep */
+	if (frev)
+	{
+		rd->rin = gzopen(frev, "rb");
+		if (!rd->rin)
+		{
+			errstr = strerror(errno);
+			logerror(lf, "%s:%d Unable to open file \'%s\': %s.\n", __func__, __LINE__,
+			         frev, errstr);
+			return NULL;
+		}
+		rd->rcarry = malloc(BUFLEN);
+		if (UNLIKELY(!rd->rcarry))
+		{
+			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+			return NULL;
+		}
+	}
+
+	return rd;
+}
+
+int read_block(BLOCK_READER *rd, PARSE_BLOCK *pb, FILE *lf)
+{
+	int ret = 0;
+	size_t flen = 0;
+	size_t rlen = 0;
+	size_t nlf = 0;
+	size_t nlr = 0;
+	size_t nl = 0;
+	bool at_end = false;
+
+	while (1)
+	{
+		/* Read block from forward file behind the carried-over partial entry */
+		ret = fill_buffer(rd->fin, pb->buffer, rd->carry, rd->carry_len, &flen);
+		if (ret)
+		{
+			logerror(lf, "%s:%d Failed to read data from file \'%s\'.\n", __func__,
+			         __LINE__, rd->ffor);
+			return -1;
+		}
+		nl = nlf = count_lines(pb->buffer);
+		at_end = gzeof(rd->fin);
+
+		/* Read the same stretch of the reverse file */
+		if (rd->rin)
+		{
+			ret = fill_buffer(rd->rin, pb->rbuffer, rd->rcarry, rd->rcarry_len, &rlen);
+			if (ret)
+			{
+				logerror(lf, "%s:%d Failed to read data from file \'%s\'.\n", __func__,
+				         __LINE__, rd->frev);
+				return -1;
+			}
+			nlr = count_lines(pb->rbuffer);
+			at_end = at_end && gzeof(rd->rin);
+
+			/* Only hand out entries that are present in both files */
+			if (nlr < nl)
+				nl = nlr;
+		}
+		nl -= nl % 4;
+		if (nl > 0)
+			break;
+
+		/* No whole entry left in the block */
+		if (at_end)
+		{
+			if (rd->rin && (flen > 0 || rlen > 0))
+			{
+				logerror(lf, "%s:%d Files \'%s\' and \'%s\' hold different numbers of "
+				         "fastQ entries.\n", __func__, __LINE__, rd->ffor, rd->frev);
+				return -1;
+			}
+			if (flen > 0)
+				logwarn(lf, "Ignoring incomplete fastQ entry at end of \'%s\'.\n", rd->ffor);
+			return 0;
+		}
+		if (flen >= BUFLEN - 2u || rlen >= BUFLEN - 2u)
+		{
+			logerror(lf, "%s:%d fastQ entry longer than the %d byte input buffer.\n",
+			         __func__, __LINE__, BUFLEN);
+			return -1;
+		}
+
+		/* Short read from the stream-- keep everything and try again */
+		rd->carry_len = save_carry(rd->carry, pb->buffer, 0);
+		if (rd->rin)
+			rd->rcarry_len = save_carry(rd->rcarry, pb->rbuffer, 0);
+	}
+
+	/* Terminate the lines handed out and keep the rest for the next block */
+	rd->carry_len = save_carry(rd->carry, pb->buffer, nl);
+	if (rd->rin)
+		rd->rcarry_len = save_carry(rd->rcarry, pb->rbuffer, nl);
+	pb->nlines = nl;
+
+	return 1;
+}
+
+void reader_close(BLOCK_READER *rd)
+{
+	if (!rd)
+		return;
+	gzclose(rd->fin);
+	if (rd->rin)
+		gzclose(rd->rin);
+	free(rd->carry);
+	free(rd->rcarry);
+	free(rd);
+}
+
+static int fill_buffer(gzFile in, char *buff, const char *carry, const size_t carry_len, size_t *len)
+{
+	int bytes_read = 0;
+
+	if (carry_len > 0)
+		memcpy(buff, carry, carry_len);
+
+	/* Leave room for a missing final newline and the null terminator */
+	bytes_read = gzread(in, &buff[carry_len], BUFLEN - carry_len - 2u);
+	if (bytes_read < 0)
+		return 1;
+	*len = carry_len + bytes_read;
+
+	/* Supply the newline if the file does not end with one */
+	if (bytes_read == 0 && *len > 0 && buff[*len - 1u] != '\n')
+		buff[(*len)++] = '\n';
+	buff[*len] = '\0';
+
+	return 0;
+}
+
+static size_t save_carry(char *carry, char *buff, size_t nl)
+{
+	char *r = NULL;
+	size_t br = 0;
+
+	/* Null-terminate the first nl lines */
+	r = nl > 0 ? clean_buffer(buff, &nl) : buff;
+	if (!r)
+		r = buff;
+	br = strlen(r);
+	if (br > 0)
+		memcpy(carry, r, br);
+
+	return br;
+}
+
+FASTQ_READER *fqreader_open(const char *filename, FILE *lf)
+{
+	char *errstr = NULL;
+	gzFile in;
+
+	in = gzopen(filename, "rb");
+	if (!in)
+	{
+		errstr = strerror(errno);
+		logerror(lf, "%s:%d Unable to open input file \'%s\': %s.\n", __func__, __LINE__,
+		         filename, errstr);
+		return NULL;
+	}
+
+	return fqreader_init(in, filename, BUFLEN, lf);
+}
+
+FASTQ_READER *fqreader_dopen(const int fd, const char *name, const size_t size, FILE *lf)
+{
+	gzFile in;
+
+	in = gzdopen(fd, "rb");
+	if (!in)
+	{
+		logerror(lf, "%s:%d Unable to open input file \'%s\'.\n", __func__, __LINE__, name);
+		return NULL;
+	}
+
+	return fqreader_init(in, name, size, lf);
+}
+
+int fqreader_next(FASTQ_READER *fr, FASTQ_VIEW *v)
+{
+	int ret = 0;
+
+	if (fr->next == fr->nent)
+	{
+		ret = fill_views(fr);
+		if (ret <= 0)
+			return ret;
+	}
+	*v = fr->views[fr->next++];
+
+	return 1;
+}
+
+void fqreader_close(FASTQ_READER *fr)
+{
+	if (!fr)
+		return;
+	gzclose(fr->in);
+	free(fr->buff);
+	free(fr->views);
+	free(fr);
+}
+
+static FASTQ_READER *fqreader_init(gzFile in, const char *filename, const size_t size, FILE *lf)
+{
+	FASTQ_READER *fr = NULL;
+
+	fr = calloc(1, sizeof(FASTQ_READER));
+	if (UNLIKELY(!fr))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		gzclose(in);
+		return NULL;
+	}
+	fr->buff = malloc(size);
+	if (UNLIKELY(!fr->buff))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		gzclose(in);
+		free(fr);
+		return NULL;
+	}
+	fr->in = in;
+	fr->filename = filename;
+	fr->size = size;
+	fr->lf = lf;
+
+	return fr;
+}
+
+static int fill_views(FASTQ_READER *fr)
+{
+	char *tmp = NULL;
+	int n = 0;
+	size_t tail = 0;
+
+	fr->next = 0;
+	fr->nent = 0;
+	while (1)
+	{
+		/* Move the partial entry left at the end of the last block to the front */
+		tail = fr->len - fr->used;
+		if (tail > 0 && fr->used > 0)
+			memmove(fr->buff, fr->buff + fr->used, tail);
+		fr->len = tail;
+		fr->used = 0;
+		if (fr->at_end)
+		{
+			if (tail > 0)
+				logwarn(fr->lf, "Ignoring incomplete fastQ entry at end of \'%s\'.\n",
+				        fr->filename);
+			fr->len = 0;
+			return 0;
+		}
+
+		/* An entry that does not fit doubles the buffer, so lines have no length limit */
+		if (tail == fr->size)
+		{
+			tmp = realloc(fr->buff, 2u * fr->size);
+			if (UNLIKELY(!tmp))
+			{
+				logerror(fr->lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+				return -1;
+			}
+			fr->buff = tmp;
+			fr->size *= 2u;
+		}
+
+		n = gzread(fr->in, fr->buff + tail, (unsigned int)(fr->size - tail));
+		if (n < 0)
+		{
+			logerror(fr->lf, "%s:%d Failed to read data from file \'%s\'.\n", __func__,
+			         __LINE__, fr->filename);
+			return -1;
+		}
+		fr->len += (size_t)n;
+
+		/* Supply the newline if the file does not end with one */
+		if (n == 0)
+		{
+			fr->at_end = true;
+			if (fr->len > 0 && fr->buff[fr->len - 1u] != '\n')
+				fr->buff[fr->len++] = '\n';
+		}
+
+		if (index_views(fr))
+			return -1;
+		if (fr->nent > 0)
+			return 1;
+	}
+}
+
+static int index_views(FASTQ_READER *fr)
+{
+	char *p = fr->buff;
+	char *s = NULL;
+	char *end = fr->buff + fr->len;
+	char *nl[4];
+	int i = 0;
+	FASTQ_VIEW *tmp = NULL;
+	FASTQ_VIEW *v = NULL;
+
+	/* Find the line ends of every whole entry in one pass over the block */
+	while (1)
+	{
+		for (s = p, i = 0; i < 4; i++)
+		{
+			nl[i] = memchr(s, '\n', (size_t)(end - s));
+			if (!nl[i])
+				return 0;
+			s = nl[i] + 1;
+		}
+		if (fr->nent == fr->vcap)
+		{
+			fr->vcap = fr->vcap ? fr->vcap << 1 : 1024u;
+			tmp = realloc(fr->views, fr->vcap * sizeof(FASTQ_VIEW));
+			if (UNLIKELY(!tmp))
+			{
+				logerror(fr->lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+				return 1;
+			}
+			fr->views = tmp;
+		}
+
+		/* Null-terminate the lines once the entry is known to be whole */
+		v = &fr->views[fr->nent++];
+		v->id = p;
+		v->id_len = (size_t)(nl[0] - p);
+		v->seq = nl[0] + 1;
+		v->seq_len = (size_t)(nl[1] - v->seq);
+		v->qual = nl[2] + 1;
+		v->qual_len = (size_t)(nl[3] - v->qual);
+		for (i = 0; i < 4; i++)
+			*nl[i] = '\0';
+		p = s;
+		fr->used = (size_t)(p - fr->buff);
+	}
+}
@@ -0,0 +1,264 @@
+/* file: build_neighbors.c
+ * description: Builds the table of sequences within edit distance of a pool's barcodes
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "khash.h"
+#include "ddradseq.h"
+
+/* Bases that may be substituted or inserted into a barcode */
+static const char alphabet[] = "ACGTN";
+
+/* Set of sequences already reached from the current barcode */
+KHASH_SET_INIT_STR(seqset)
+
+/* Function prototypes */
+static int add_sequence(const char *s, khash_t(seqset) *seen, char ***level, size_t *n,
+                        size_t *cap);
+static int add_neighbor(POOL *pl, const char *s, BARCODE *bc, const int d);
+
+int build_neighbors(POOL *pl, const int dist, FILE *lf)
+{
+	char *s = NULL;
+	char *t = NULL;
+	char **curr = NULL;
+	char **next = NULL;
+	char **swap = NULL;
+	const char *bkey = NULL;
+	int e = 0;
+	int ret = 0;
+	size_t bl = pl->barcode_length;
+	size_t len = 0;
+	size_t lo = 0;
+	size_t hi = 0;
+	size_t x = 0;
+	size_t y = 0;
+	size_t c = 0;
+	size_t ncurr = 0;
+	size_t nnext = 0;
+	size_t ccurr = 0;
+	size_t cnext = 0;
+	size_t namb = 0;
+	khint_t k = 0;
+	khint_t kk = 0;
+	khash_t(barcode) *b = pl->b;
+	khash_t(seqset) *seen = NULL;
+	BARCODE *bc = NULL;
+
+	/* Barcodes too long to pack are compared directly */
+	if (bl > MAX_PACKED_LENGTH)
+	{
+		pl->nb = NULL;
+		loginfo(lf, "Pool %s: barcodes longer than %d bases will be compared directly.\n",
+		        pl->poolID, MAX_PACKED_LENGTH);
+		return 0;
+	}
+
+	pl->nb = kh_init(neighbor);
+	seen = kh_init(seqset);
+	t = malloc(bl + (dist > 0 ? dist : 0) + 2u);
+	if (UNLIKELY(!pl->nb || !seen || !t))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return 1;
+	}
+
+	for (k = kh_begin(b); k != kh_end(b); k++)
+	{
+		if (!kh_exist(b, k))
+			continue;
+		bkey = kh_key(b, k);
+		bc = kh_value(b, k);
+
+		/* Breadth-first walk outward from the barcode, one edit per level */
+		ncurr = 0;
+		if (add_sequence(bkey, seen, &curr, &ncurr, &ccurr))
+			goto nomem;
+		for (e = 1; e <= dist; e++)
+		{
+			/* Only keep sequences that can still be edited back to length bl */
+			lo = bl > (size_t)(dist - e) ? bl - (dist - e) : 0;
+			hi = bl + (dist - e);
+			nnext = 0;
+			for (x = 0; x < ncurr; x++)
+			{
+				s = curr[x];
+				len = strlen(s);
+
+				/* Substitutions */
+				if (len >= lo && len <= hi)
+				{
+					for (y = 0; y < len; y++)
+					{
+						memcpy(t, s, len + 1u);
+						for (c = 0; alphabet[c]; c++)
+						{
+							if (alphabet[c] == s[y])
+								continue;
+							t[y] = alphabet[c];
+							if (add_sequence(t, seen, &next, &nnext, &cnext))
+								goto nomem;
+							if (kh_size(seen) > MAX_NEIGHBORS)
+								goto toolarge;
+						}
+					}
+				}
+
+				/* Deletions */
+				if (len > 0 && len - 1u >= lo && len - 1u <= hi)
+				{
+					for (y = 0; y < len; y++)
+					{
+						memcpy(t, s, y);
+						memcpy(t + y, s + y + 1u, len - y);
+						if (add_sequence(t, seen, &next, &nnext, &cnext))
+							goto nomem;
+						if (kh_size(seen) > MAX_NEIGHBORS)
+							goto toolarge;
+					}
+				}
+
+				/* Insertions */
+				if (len + 1u >= lo && len + 1u <= hi)
+				{
+					for (y = 0; y <= len; y++)
+					{
+						memcpy(t, s, y);
+						memcpy(t + y + 1u, s + y, len - y + 1u);
+						for (c = 0; alphabet[c]; c++)
+						{
+							t[y] = alphabet[c];
+							if (add_sequence(t, seen, &next, &nnext, &cnext))
+								goto nomem;
+							if (kh_size(seen) > MAX_NEIGHBORS)
+								goto toolarge;
+						}
+					}
+				}
+			}
+			swap = curr;
+			curr = next;
+			next = swap;
+			x = ccurr;
+			ccurr = cnext;
+			cnext = x;
+			ncurr = nnext;
+		}
+
+		/* Every reached sequence of barcode length is a candidate read barcode */
+		for (kk = kh_begin(seen); kk != kh_end(seen); kk++)
+		{
+			if (!kh_exist(seen, kk))
+				continue;
+			s = (char*)kh_key(seen, kk);
+			if (strlen(s) == bl && !ret)
+				ret = add_neighbor(pl, s, bc, levenshtein(bkey, bl, s, bl, dist));
+			free(s);
+		}
+		kh_clear(seqset, seen);
+		if (ret)
+			goto nomem;
+		if (kh_size(pl->nb) > MAX_NEIGHBORS)
+			goto toolarge;
+	}
+
+	/* Count the sequences that cannot be assigned to a single sample */
+	for (kk = kh_begin(pl->nb); kk != kh_end(pl->nb); kk++)
+		if (kh_exist(pl->nb, kk) && kh_value(pl->nb, kk).bc == NULL)
+			namb++;
+	loginfo(lf, "Pool %s: %u barcode sequences within edit distance %d, %zu ambiguous.\n",
+	        pl->poolID, kh_size(pl->nb), dist, namb);
+
+	kh_destroy(seqset, seen);
+	free(curr);
+	free(next);
+	free(t);
+
+	return 0;
+
+toolarge:
+	/* Pools with too many near sequences fall back to scoring every barcode */
+	for (kk = kh_begin(seen); kk != kh_end(seen); kk++)
+		if (kh_exist(seen, kk))
+			free((char*)kh_key(seen, kk));
+	kh_destroy(neighbor, pl->nb);
+	pl->nb = NULL;
+	kh_destroy(seqset, seen);
+	free(curr);
+	free(next);
+	free(t);
+	loginfo(lf, "Pool %s: more than %d sequences within edit distance %d, barcodes will be compared directly.\n",
+	        pl->poolID, MAX_NEIGHBORS, dist);
+	return 0;
+
+nomem:
+	logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+	return 1;
+}
+
+static int add_sequence(const char *s, khash_t(seqset) *seen, char ***level, size_t *n,
+                        size_t *cap)
+{
+	int a = 0;
+	char *tmp = NULL;
+	char **p = NULL;
+	khint_t k = 0;
+
+	k = kh_get(seqset, seen, s);
+	if (k != kh_end(seen))
+		return 0;
+	tmp = strdup(s);
+	if (UNLIKELY(!tmp))
+		return 1;
+	kh_put(seqset, seen, tmp, &a);
+
+	/* Queue the new sequence for the next level of edits */
+	if (*n == *cap)
+	{
+		*cap = *cap ? *cap << 1 : 64u;
+		p = realloc(*level, *cap * sizeof(char*));
+		if (UNLIKELY(!p))
+			return 1;
+		*level = p;
+	}
+	(*level)[(*n)++] = tmp;
+
+	return 0;
+}
+
+static int add_neighbor(POOL *pl, const char *s, BARCODE *bc, const int d)
+{
+	int a = 0;
+	khint_t k = 0;
+	NEIGHBOR *nb = NULL;
+
+	k = kh_put(neighbor, pl->nb, pack_dna(s, pl->barcode_length), &a);
+	if (UNLIKELY(a < 0))
+		return 1;
+	nb = &kh_value(pl->nb, k);
+	if (a)
+	{
+		nb->bc = bc;
+		nb->dist = d;
+		return 0;
+	}
+
+	/* The nearest barcode wins; a tie leaves the sequence ambiguous */
+	if (d < nb->dist)
+	{
+		nb->bc = bc;
+		nb->dist = d;
+	}
+	else if (d == nb->dist && nb->bc != bc)
+	{
+		nb->bc = NULL;
+	}
+
+	return 0;
+}
@@ -142,94 +142,98 @@ int create_dirtree(const CMD *cp, const khash_t(pool_hash) *h)
 								return 1;
 							}
 						}
-						strl = strlen(pooldir);
-						parsedir = malloc(strl + 7u);
-						if (UNLIKELY(!parsedir))
+						/* Fused runs write only the final files */
+						if (!cp->fused)
 						{
-							logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-							return 1;
-						}
-						strcpy(parsedir, pooldir);
-						strcat(parsedir, "/parse");
-						d = opendir(parsedir);
+							strl = strlen(pooldir);
+							parsedir = malloc(strl + 7u);
+							if (UNLIKELY(!parsedir))
+							{
+								logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+								return 1;
+							}
+							strcpy(parsedir, pooldir);
+							strcat(parsedir, "/parse");
+							d = opendir(parsedir);
 
-						/* If the subsubdirectory doesn't already exist */
-						/* create it */
-						if (d)
-						{
-							/* If directory already exists-- delete all files */
-							while ((next_file = readdir(d)) != NULL)
+							/* If the subsubdirectory doesn't already exist */
+							/* create it */
+							if (d)
 							{
-								sprintf(filepath, "%s/%s", parsedir, next_file->d_name);
-								remove(filepath);
+								/* If directory already exists-- delete all files */
+								while ((next_file = readdir(d)) != NULL)
+								{
+									sprintf(filepath, "%s/%s", parsedir, next_file->d_name);
+									remove(filepath);
+								}
+								closedir(d);
 							}
-							closedir(d);
-						}
-						else if (errno == ENOENT)
-						{
-							status = mkdir(parsedir, S_IRWXU | S_IRGRP |
-													 S_IXGRP | S_IROTH | S_IXOTH);
-							if (status < 0)
+							else if (errno == ENOENT)
 							{
-								char *errstr = strerror(errno);
-								logerror(lf, "%s:%d Failed to create parse directory "
-								         "\'%s\': %s.\n", __func__, __LINE__, parsedir,
-										 errstr);
+								status = mkdir(parsedir, S_IRWXU | S_IRGRP |
+														 S_IXGRP | S_IROTH | S_IXOTH);
+								if (status < 0)
+								{
+									char *errstr = strerror(errno);
+									logerror(lf, "%s:%d Failed to create parse directory "
+									         "\'%s\': %s.\n", __func__, __LINE__, parsedir,
+											 errstr);
+									return 1;
+								}
+							}
+							else
+							{
+								errstr = strerror(errno);
+								logerror(lf, "%s:%d Failed to create parse directory \'%s\': %s.\n",
+										 __func__, __LINE__, parsedir, errstr);
 								return 1;
 							}
-						}
-						else
-						{
-							errstr = strerror(errno);
-							logerror(lf, "%s:%d Failed to create parse directory \'%s\': %s.\n",
-									 __func__, __LINE__, parsedir, errstr);
-							return 1;
-						}
-						free(parsedir);
-						strl = strlen(pooldir);
-						pairdir = malloc(strl + 7u);
-						if (UNLIKELY(!pairdir))
-						{
-							logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-							return 1;
-						}
-						strcpy(pairdir, pooldir);
-						strcat(pairdir, "/pairs");
-						d = opendir(pairdir);
+							free(parsedir);
+							strl = strlen(pooldir);
+							pairdir = malloc(strl + 7u);
+							if (UNLIKELY(!pairdir))
+							{
+								logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+								return 1;
+							}
+							strcpy(pairdir, pooldir);
+							strcat(pairdir, "/pairs");
+							d = opendir(pairdir);
 
-						/* If the subsubdirectory doesn't already exist */
-						/* create it */
-						if (d)
-						{
-							/* If directory already exists-- delete all files */
-							while ((next_file = readdir(d)) != NULL)
+							/* If the subsubdirectory doesn't already exist */
+							/* create it */
+							if (d)
 							{
-								sprintf(filepath, "%s/%s", pairdir, next_file->d_name);
-								remove(filepath);
+								/* If directory already exists-- delete all files */
+								while ((next_file = readdir(d)) != NULL)
+								{
+									sprintf(filepath, "%s/%s", pairdir, next_file->d_name);
+									remove(filepath);
+								}
+								closedir(d);
 							}
-							closedir(d);
-						}
-						else if (errno == ENOENT)
-						{
-							status = mkdir(pairdir, S_IRWXU | S_IRGRP |
-													S_IXGRP | S_IROTH | S_IXOTH);
-							if (status < 0)
+							else if (errno == ENOENT)
 							{
-								char *errstr = strerror(errno);
-								logerror(lf, "%s:%d Failed to create pairs directory "
-								         "\'%s\': %s.\n", __func__, __LINE__, pairdir,
-										 errstr);
+								status = mkdir(pairdir, S_IRWXU | S_IRGRP |
+														S_IXGRP | S_IROTH | S_IXOTH);
+								if (status < 0)
+								{
+									char *errstr = strerror(errno);
+									logerror(lf, "%s:%d Failed to create pairs directory "
+									         "\'%s\': %s.\n", __func__, __LINE__, pairdir,
+											 errstr);
+									return 1;
+								}
+							}
+							else
+							{
+								errstr = strerror(errno);
+								logerror(lf, "%s:%d Failed to create pairs directory \'%s\': %s.\n",
+											__func__, __LINE__, pairdir, errstr);
 								return 1;
 							}
+							free(pairdir);
 						}
-						else
-						{
-							errstr = strerror(errno);
-							logerror(lf, "%s:%d Failed to create pairs directory \'%s\': %s.\n",
-										__func__, __LINE__, pairdir, errstr);
-							return 1;
-						}
-						free(pairdir);
 						strl = strlen(pooldir);
 						trimdir = malloc(strl + 7u);
 						if (UNLIKELY(!trimdir))
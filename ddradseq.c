@@ -37,7 +37,8 @@ int main(int argc, char *argv[])
 	}
 
 	/* Run the pair pipeline stage */
-	if (string_equal(cp->mode, "pair") || string_equal(cp->mode, "all"))
+	/* Lockstep parsing writes its output already paired */
+	if (string_equal(cp->mode, "pair") || (string_equal(cp->mode, "all") && !cp->lockstep))
 	{
 		ret = pair_main(cp);
 		if (ret)
@@ -45,7 +46,8 @@ int main(int argc, char *argv[])
 	}
 
 	/* Run the trimend pipeline stage */
-	if (string_equal(cp->mode, "trimend") || string_equal(cp->mode, "all"))
+	/* Fused parsing writes its output already trimmed */
+	if (string_equal(cp->mode, "trimend") || (string_equal(cp->mode, "all") && !cp->fused))
 	{
 		ret = trimend_main(cp);
 		if (ret)
@@ -18,7 +18,10 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
 #include <emmintrin.h>
+#include <zlib.h>
 #include "khash.h"
 
 #ifdef __GNUC__
@@ -36,16 +39,22 @@
 #define BUFLEN 0x20000
 
 /** @def MAX_LINE_LENGTH
- *  @brief Maximum line length to read from input file.
+ *  @brief Maximum length of a CSV database line or a read key held on the stack.
  */
 
 #define MAX_LINE_LENGTH 400
 
-/** @def BSIZE
- *  @brief Number of lines in individual parse buffers.
+/** @def MERGE_BUFLEN
+ *  @brief Initial size of the input buffer of each sorted run being merged.
  */
 
-#define BSIZE 4000
+#define MERGE_BUFLEN 0x4000
+
+/** @def FASTQ_SIZE
+ *  @brief Number of bytes taken by a copy of a fastQ entry made with copy_fastq.
+ */
+
+#define FASTQ_SIZE(v) (sizeof(FASTQ_VIEW) + (v)->id_len + (v)->seq_len + (v)->qual_len + 3u)
 
 /** @def DNAME_LENGTH
  *  @brief Length of terminal output directory name.
@@ -65,6 +74,121 @@
 
 #define REVERSE 2
 
+/** @def PAIRED
+ *  @brief Identifier for mate-pairs read together from forward and reverse files.
+ */
+
+#define PAIRED 3
+
+/** @def MAX_NEIGHBORS
+ *  @brief Maximum number of sequences tabulated within edit distance of a pool's barcodes.
+ */
+
+#define MAX_NEIGHBORS 0x100000
+
+/** @def MAX_PACKED_LENGTH
+ *  @brief Longest DNA sequence packed two bits per base into an integer hash key.
+ */
+
+#define MAX_PACKED_LENGTH 19
+
+/** @def PACK_ESCAPE
+ *  @brief Flag marking a hashed rather than packed integer key.
+ */
+
+#define PACK_ESCAPE ((uint64_t)1 << 63)
+
+/** @def MAX_OPEN_STREAMS
+ *  @brief Maximum number of sample output streams held open at once.
+ */
+
+#define MAX_OPEN_STREAMS 1024
+
+/** @def FD_RESERVE
+ *  @brief Number of file descriptors left free for input files when sizing the stream cache.
+ */
+
+#define FD_RESERVE 32
+
+/** @def BGZF_BLOCK_SIZE
+ *  @brief Maximum number of uncompressed bytes in one BGZF block.
+ */
+
+#define BGZF_BLOCK_SIZE 0xff00
+
+/** @def BGZF_MAX_BLOCK_SIZE
+ *  @brief Maximum size of one compressed BGZF block.
+ */
+
+#define BGZF_MAX_BLOCK_SIZE 0x10000
+
+/** @def POOL_MEMO_SIZE
+ *  @brief Number of recently seen flow cell and index pairs remembered by each parse thread.
+ */
+
+#define POOL_MEMO_SIZE 16
+
+/** @def MEMO_KEY_LENGTH
+ *  @brief Longest flow cell identifier or index sequence remembered by a pool memo.
+ */
+
+#define MEMO_KEY_LENGTH 32
+
+/** @def MAX_READ_PREFIXES
+ *  @brief Number of run and flow cell pairs whose read keys can be packed into 64 bits.
+ */
+
+#define MAX_READ_PREFIXES 64
+
+/** @def PREFIX_UNKNOWN
+ *  @brief Return value when a read key would pack but its run and flow cell are not yet numbered.
+ */
+
+#define PREFIX_UNKNOWN 2
+
+/** @def MATE_SKIPPED
+ *  @brief Sample index recorded in the mate table for a forward read assigned to no sample.
+ */
+
+#define MATE_SKIPPED UINT32_MAX
+
+/** @def MATE_TABLE_INIT_SIZE
+ *  @brief Initial number of slots in the mate table.
+ */
+
+#define MATE_TABLE_INIT_SIZE 0x10000
+
+/** @def ARENA_BLOCK_SIZE
+ *  @brief Size of each block of memory carved up by an arena.
+ */
+
+#define ARENA_BLOCK_SIZE 0x100000
+
+/** @def MAX_MERGE_RUNS
+ *  @brief Maximum number of sorted runs merged at once when pairing out of memory,
+ *         lowered by sort_run_limit to fit the descriptor limit.
+ */
+
+#define MAX_MERGE_RUNS 256
+
+/** @def MEM_EXCEEDED
+ *  @brief Return value when pairing a sample in memory would pass the memory budget.
+ */
+
+#define MEM_EXCEEDED 2
+
+/** @def BATCH_LANES
+ *  @brief Number of barcodes scored together in one SSE2 vector.
+ */
+
+#define BATCH_LANES 8
+
+/** @def ALIGN_LANES
+ *  @brief Number of mate pairs aligned together, one to each byte of an AVX-512 vector.
+ */
+
+#define ALIGN_LANES 64
+
 /** @def DATELEN
  *  @brief Length of data format YYYY-DD-MM.
  */
@@ -108,6 +232,8 @@ typedef struct cmdparam_t
 {
 	bool across;          /**< Flag to pool sequences across flow cells. */
 	bool mt_mode;         /**< Flag to indicate multi-threaded mode. */
+	bool lockstep;        /**< Flag to parse forward and reverse files together. */
+	bool fused;           /**< Flag to trim mates as they are parsed, writing only the final files. */
 	char *parent_indir;   /**< String holding the full path and name of the parent input directory. */
 	char *parent_outdir;  /**< String holding the full path to the parent output directory. */
 	char *outdir;         /**< String holding the full path to the output directory. */
@@ -118,20 +244,42 @@ typedef struct cmdparam_t
 	int score;            /**< The alignment score to consider mates properly paired. */
 	int gapo;             /**< The penalty for opening an alignment gap. */
 	int gape;             /**< The penalty for extending an open alignment gap. */
+	int insert_min;       /**< The shortest expected insert, for trimming by overlap alignment. */
+	int insert_max;       /**< The longest expected insert, for trimming by overlap alignment, or zero to trim by local alignment. */
 	int nthreads;         /**< The number of threads to use for parallel computation. */
+	int window;           /**< The number of forward entries read ahead to find a mate, or zero to load the forward file. */
+	size_t max_mem;       /**< The memory budget in bytes for pairing, shared by the samples paired at once, or zero for no limit. */
 	FILE *lf;             /**< Pointer to the log file output stream. */
 } CMD;
 
-/** @var typedef struct fastq_t FASTQ
- *  @brief Data structure to hold a single fastQ entry.
+/** @var typedef struct fastq_view_t FASTQ_VIEW
+ *  @brief Pointers into an input buffer delimiting a single fastQ entry.
+ */
+
+typedef struct fastq_view_t
+{
+	const char *id;     /**< Start of the Illumina identifier line. */
+	size_t id_len;      /**< Length of the Illumina identifier line. */
+	const char *seq;    /**< Start of the DNA sequence line. */
+	size_t seq_len;     /**< Length of the DNA sequence line. */
+	const char *qual;   /**< Start of the DNA sequence quality line. */
+	size_t qual_len;    /**< Length of the DNA sequence quality line. */
+} FASTQ_VIEW;
+
+
+/** @var typedef struct illumina_id_t ILLUMINA_ID
+ *  @brief Pointers to the fields of an Illumina identifier line used for parsing.
  */
 
-typedef struct fastq_t
+typedef struct illumina_id_t
 {
-	char *id;       /**< String holding the Illumina identifier line for a fastQ entry. */
-	char *seq;      /**< String holding the DNA sequence line for a fastQ entry. */
-	char *qual;     /**< String holding the DNA sequence quality line for a fastQ entry. */
-} FASTQ;
+	const char *key;        /**< Start of the mate-pair key (run through y-coordinate). */
+	size_t key_len;         /**< Length of the mate-pair key. */
+	const char *flowcell;   /**< Start of the flow cell identifier. */
+	size_t flowcell_len;    /**< Length of the flow cell identifier. */
+	const char *index;      /**< Start of the multiplex index sequence. */
+	size_t index_len;       /**< Length of the multiplex index sequence. */
+} ILLUMINA_ID;
 
 
 /** @var typedef struct ksqr_t ALIGN_RESULT
@@ -169,6 +317,251 @@ typedef struct kswq_t
 } ALIGN_QUERY;
 
 
+/** @var typedef struct align_work_t ALIGN_WORK
+ *  @brief Buffers for aligning mates, private to one thread and grown as longer reads are seen.
+ */
+
+typedef struct align_work_t
+{
+	void *prof;         /**< Query profile and score vectors of local_align. */
+	size_t prof_size;   /**< Bytes held for the query profile and score vectors. */
+	void *dp;           /**< Score vectors of align_batch and overlap_align. */
+	size_t dp_size;     /**< Bytes held for those score vectors. */
+	uint64_t *b;        /**< Best score of each run of target rows found by local_align. */
+	size_t b_size;      /**< Bytes held for the best scores. */
+	void *seq;          /**< Coded target and query sequences of the pairs being aligned. */
+	size_t seq_size;    /**< Bytes held for the coded sequences. */
+} ALIGN_WORK;
+
+
+/** @var typedef struct align_batch_t ALIGN_BATCH
+ *  @brief Sequence pairs aligned together, one pair to each vector lane.
+ */
+
+typedef struct align_batch_t
+{
+	int n;                            /**< The number of pairs in the batch. */
+	const char *query[ALIGN_LANES];   /**< The query sequence of each pair, coded 0-4. */
+	int qlen[ALIGN_LANES];            /**< Length of each query sequence. */
+	const char *target[ALIGN_LANES];  /**< The target sequence of each pair, coded 0-4. */
+	int tlen[ALIGN_LANES];            /**< Length of each target sequence. */
+	int minsc[ALIGN_LANES];           /**< Lowest score for which the query end of each pair is found. */
+	int endsc[ALIGN_LANES];           /**< Score at which to stop aligning each pair, as with KSW_XSTOP. */
+	ALIGN_RESULT r[ALIGN_LANES];      /**< The score and end positions of the best alignment of each pair. */
+} ALIGN_BATCH;
+
+
+/** @var typedef struct work_queue_t WORK_QUEUE
+ *  @brief Bounded queue used to pass work items between threads.
+ */
+
+typedef struct work_queue_t
+{
+	void **items;               /**< Circular array of queued work items. */
+	int size;                   /**< The capacity of the queue. */
+	int head;                   /**< Index of the next item to be removed. */
+	int count;                  /**< The number of items currently in the queue. */
+	bool closed;                /**< Flag indicating no more items will be added. */
+	pthread_mutex_t lock;       /**< Lock protecting the queue. */
+	pthread_cond_t not_empty;   /**< Signalled when an item is added. */
+	pthread_cond_t not_full;    /**< Signalled when an item is removed. */
+} WORK_QUEUE;
+
+
+/** @var typedef struct align_slots_t ALIGN_SLOTS
+ *  @brief Alignment threads shared out between the samples trimmed at once.
+ */
+
+typedef struct align_slots_t
+{
+	int nfree;                  /**< The number of alignment threads not yet taken. */
+	int npending;               /**< The number of samples yet to start aligning. */
+	int share;                  /**< The number of threads each sample starts with. */
+	pthread_mutex_t lock;       /**< Lock protecting the counts. */
+} ALIGN_SLOTS;
+
+
+/** @var typedef struct bgzf_pool_t BGZF_POOL
+ *  @brief Threads shared by all BGZF writers for compressing blocks.
+ */
+
+typedef struct bgzf_pool_t
+{
+	WORK_QUEUE *jobs;   /**< Queue of blocks waiting to be compressed. */
+	pthread_t *tid;     /**< The compression thread identifiers. */
+	int nthreads;       /**< The number of compression threads. */
+	int nring;          /**< The number of blocks each writer keeps in flight. */
+} BGZF_POOL;
+
+
+/** @var typedef int (*SAMPLE_FUNC)(const CMD*, BGZF_POOL*, const char*, const char*, void*)
+ *  @brief Processes the forward and reverse input files of one sample, returning non-zero on failure.
+ */
+
+typedef int (*SAMPLE_FUNC)(const CMD *cp, BGZF_POOL *bp, const char *fin, const char *rin, void *arg);
+
+
+/** @var typedef struct bgzf_job_t BGZF_JOB
+ *  @brief One block of a BGZF writer.
+ */
+
+typedef struct bgzf_job_t
+{
+	struct bgzf_t *fp;      /**< The writer the block belongs to. */
+	unsigned char *ubuf;    /**< The uncompressed data. */
+	size_t ulen;            /**< The number of bytes in the uncompressed data. */
+	unsigned char *cbuf;    /**< The compressed block, with header and footer. */
+	size_t clen;            /**< The number of bytes in the compressed block. */
+	int status;             /**< Whether the block is filling, queued, compressed or failed. */
+} BGZF_JOB;
+
+
+/** @var typedef struct bgzf_t BGZF
+ *  @brief Output file written as a series of independently compressed gzip blocks.
+ */
+
+typedef struct bgzf_t
+{
+	int fd;                 /**< The output file descriptor. */
+	const char *filename;   /**< The output file name used in log messages. */
+	BGZF_POOL *pool;        /**< The compression threads, or NULL to compress in the writing thread. */
+	BGZF_JOB *ring;         /**< Circular array of blocks in file order. */
+	int nring;              /**< The number of blocks in the ring. */
+	int head;               /**< Index of the oldest block not yet written. */
+	int npending;           /**< The number of blocks handed to the compression threads. */
+	bool failed;            /**< Flag set once a block could not be compressed or written. */
+	FILE *lf;               /**< Pointer to log file stream. */
+	pthread_mutex_t lock;   /**< Lock protecting the status of the blocks. */
+	pthread_cond_t done;    /**< Signalled when a block has been compressed. */
+} BGZF;
+
+
+/** @var typedef struct arena_block_t ARENA_BLOCK
+ *  @brief One block of memory carved up by an arena.
+ */
+
+typedef struct arena_block_t
+{
+	struct arena_block_t *next;   /**< The block filled before this one. */
+	size_t cap;                   /**< The number of bytes of data in the block. */
+	size_t used;                  /**< The number of bytes handed out so far. */
+	unsigned char data[];         /**< The records stored in the block. */
+} ARENA_BLOCK;
+
+
+/** @var typedef struct arena_t ARENA
+ *  @brief Bump-pointer allocator whose records are all freed together.
+ */
+
+typedef struct arena_t
+{
+	ARENA_BLOCK *head;   /**< The block currently being filled. */
+	size_t size;         /**< The total number of bytes allocated from the heap. */
+	size_t used;         /**< The total number of bytes handed out of the blocks. */
+} ARENA;
+
+
+/** @var typedef struct parse_block_t PARSE_BLOCK
+ *  @brief Block of whole fastQ entries handed to a parse thread.
+ */
+
+typedef struct parse_block_t
+{
+	char *buffer;       /**< Null-delimited lines of the fastQ entries in the block. */
+	char *rbuffer;      /**< Null-delimited lines of the reverse mates when reading in lockstep. */
+	size_t nlines;      /**< The number of lines in the block (in each buffer). */
+} PARSE_BLOCK;
+
+
+/** @var typedef struct block_reader_t BLOCK_READER
+ *  @brief Input stream state for reading blocks of whole fastQ entries.
+ */
+
+typedef struct block_reader_t
+{
+	const char *ffor;   /**< Name of the forward (or only) input file. */
+	const char *frev;   /**< Name of the reverse input file, or NULL. */
+	gzFile fin;         /**< Forward input file stream. */
+	gzFile rin;         /**< Reverse input file stream, or NULL. */
+	char *carry;        /**< Partial entries left over from the last forward block. */
+	size_t carry_len;   /**< The number of bytes in the forward carry buffer. */
+	char *rcarry;       /**< Partial entries left over from the last reverse block. */
+	size_t rcarry_len;  /**< The number of bytes in the reverse carry buffer. */
+} BLOCK_READER;
+
+
+/** @var typedef struct fastq_reader_t FASTQ_READER
+ *  @brief Input stream handing out single fastQ entries from large decompressed blocks.
+ */
+
+typedef struct fastq_reader_t
+{
+	gzFile in;              /**< The input stream. */
+	const char *filename;   /**< Name of the input file used in log messages. */
+	char *buff;             /**< Decompressed data; the lines of indexed entries are null-terminated. */
+	size_t size;            /**< The capacity of the buffer, doubled for an entry that does not fit. */
+	size_t len;             /**< The number of bytes in the buffer. */
+	size_t used;            /**< The number of bytes taken by whole entries; the rest waits for more data. */
+	FASTQ_VIEW *views;      /**< The whole entries in the buffer. */
+	size_t nent;            /**< The number of whole entries in the buffer. */
+	size_t next;            /**< Index of the next entry to hand out. */
+	size_t vcap;            /**< The capacity of the array of entries. */
+	bool at_end;            /**< Flag set once the input stream is exhausted. */
+	FILE *lf;               /**< Pointer to log file stream. */
+} FASTQ_READER;
+
+
+/** @var typedef struct sort_runs_t SORT_RUNS
+ *  @brief Sorted runs of fastQ entries spilled to temporary files and merged by read key.
+ */
+
+typedef struct sort_runs_t
+{
+	int fd[MAX_MERGE_RUNS];              /**< The run files, in input file order. */
+	FASTQ_READER *fr[MAX_MERGE_RUNS];    /**< Reader of each run file while the runs are merged. */
+	FASTQ_VIEW v[MAX_MERGE_RUNS];        /**< The next entry of each run. */
+	const char *key[MAX_MERGE_RUNS];     /**< The read key of each run's next entry. */
+	size_t klen[MAX_MERGE_RUNS];         /**< Length of the read key of each run's next entry. */
+	int heap[MAX_MERGE_RUNS];            /**< Runs with entries left, ordered by their next entry. */
+	int nruns;                           /**< The number of runs. */
+	int max_runs;                        /**< The number of runs kept open before they are merged into one. */
+	int nheap;                           /**< The number of runs in the heap. */
+	char *rec;                           /**< Copy of the entry last handed out by the merge. */
+	size_t rec_size;                     /**< The capacity of the copy. */
+	const char *prefix;                  /**< Path prefix of the temporary run files. */
+} SORT_RUNS;
+
+
+/** @var typedef struct out_stream_t OUT_STREAM
+ *  @brief Compressed output stream kept open across buffer flushes.
+ */
+
+typedef struct out_stream_t
+{
+	char *filename;              /**< The full path to the output file. */
+	BGZF *fp;                    /**< The open output stream, or NULL if closed. */
+	bool busy;                   /**< Flag set while the stream is being written. */
+	bool closing;                /**< Flag set while an eviction closes the stream. */
+	struct out_stream_t *prev;   /**< The next more recently used open stream. */
+	struct out_stream_t *next;   /**< The next less recently used open stream. */
+} OUT_STREAM;
+
+
+/** @var typedef struct stream_cache_t STREAM_CACHE
+ *  @brief Least-recently-used list bounding the number of open output streams.
+ */
+
+typedef struct stream_cache_t
+{
+	OUT_STREAM *head;           /**< The most recently used open stream. */
+	OUT_STREAM *tail;           /**< The least recently used open stream. */
+	int nopen;                  /**< The number of open streams. */
+	int max_open;               /**< The maximum number of open streams. */
+	pthread_mutex_t lock;       /**< Lock protecting the list. */
+	pthread_cond_t released;    /**< Signalled when a stream is no longer being written or has been closed. */
+} STREAM_CACHE;
+
+
 /** @var typedef struct barcode_t BARCODE
  *  @brief Barcode-level data structure.
  */
@@ -176,9 +569,15 @@ typedef struct kswq_t
 typedef struct barcode_t
 {
 	char *smplID;       /**< The sample identifier from the CSV database file. */
-	char *outfile;      /**< The full path to the output file associated with a biological sample. */
 	char *buffer;       /**< The output buffer associated with a biological sample. */
 	size_t curr_bytes;  /**< The number of bytes currently in the output buffer associated with a biological sample. */
+	char *rbuffer;      /**< The reverse-read output buffer, only used when mates are parsed in lockstep. */
+	size_t rcurr_bytes; /**< The number of bytes currently in the reverse-read output buffer. */
+	OUT_STREAM fstream; /**< The forward-read output stream associated with a biological sample. */
+	OUT_STREAM rstream; /**< The reverse-read output stream associated with a biological sample. */
+	STREAM_CACHE *cache;   /**< Pointer to the cache of open output streams shared by all samples. */
+	pthread_mutex_t lock;  /**< Lock giving one parse thread at a time ownership of the sample output. */
+	uint32_t index;        /**< The number of the sample in the mate table. */
 } BARCODE;
 
 /** @def KHASH_MAP_INIT_STR(barcode, BARCODE*)
@@ -187,6 +586,38 @@ typedef struct barcode_t
 
 KHASH_MAP_INIT_STR(barcode, BARCODE*)
 
+/** @var typedef struct neighbor_t NEIGHBOR
+ *  @brief Sample assignment of a sequence within the allowed edit distance of a barcode.
+ */
+
+typedef struct neighbor_t
+{
+	BARCODE *bc;        /**< The sample with the nearest barcode, or NULL if two samples are equally near. */
+	int dist;           /**< The edit distance to the nearest barcode. */
+} NEIGHBOR;
+
+/** @def KHASH_MAP_INIT_INT64(neighbor, NEIGHBOR)
+ *  @brief Defines the hash of packed barcode sequences within edit distance of a pool's barcodes
+ */
+
+KHASH_MAP_INIT_INT64(neighbor, NEIGHBOR)
+
+/** @var typedef struct barcode_batch_t BARCODE_BATCH
+ *  @brief Bit-vector match masks for scoring a read against all of a pool's barcodes at once.
+ */
+
+typedef struct barcode_batch_t
+{
+	int nbc;                  /**< The number of barcodes in the batch. */
+	int nvec;                 /**< The number of vectors holding the barcodes, BATCH_LANES to a vector. */
+	size_t length;            /**< The barcode length. */
+	unsigned char code[256];  /**< Row of the match masks for each character, zero if in no barcode. */
+	__m128i *peq;             /**< Match masks, nvec vectors per character row. */
+	void *mem;                /**< Allocated block holding the aligned match masks. */
+	BARCODE **bc;             /**< The sample in each lane. */
+	const char **bkey;        /**< The database barcode sequence in each lane. */
+} BARCODE_BATCH;
+
 /** @var typedef struct pool_t POOL
  *  @brief Pool-level data structure.
  */
@@ -195,15 +626,45 @@ typedef struct pool_t
 {
 	char *poolID;            /**< The sample pool identifier from the CSV database file. */
 	char *poolpath;          /**< The full path to the output directory associated with a sample pool. */
+	char *index;             /**< The pool (index) sequence from the CSV database file. */
 	size_t barcode_length;   /**< The length of the pool identifier barcode. */
 	khash_t(barcode) *b;     /**< Pointer to the hash of samples associated with this pool. */
+	khash_t(neighbor) *nb;   /**< Pointer to the hash of sequences within edit distance of the pool's barcodes, or NULL if too large. */
+	BARCODE_BATCH *bb;       /**< Pointer to the pool's barcodes laid out for batched edit distance. */
 } POOL;
 
-/** @def KHASH_MAP_INIT_STR(pool, POOL*)
- *  @brief Defines the second-level hash
+/** @def KHASH_MAP_INIT_INT64(pool, POOL*)
+ *  @brief Defines the second-level hash, keyed by packed pool sequence
+ */
+
+KHASH_MAP_INIT_INT64(pool, POOL*)
+
+
+/** @var typedef struct pool_memo_entry_t POOL_MEMO_ENTRY
+ *  @brief A flow cell and index pair resolved to its pool.
+ */
+
+typedef struct pool_memo_entry_t
+{
+	char flowcell[MEMO_KEY_LENGTH];   /**< The flow cell identifier bytes. */
+	size_t flowcell_len;              /**< Length of the flow cell identifier. */
+	char index[MEMO_KEY_LENGTH];      /**< The index sequence bytes. */
+	size_t index_len;                 /**< Length of the index sequence. */
+	POOL *pl;                         /**< The pool the pair resolves to. */
+} POOL_MEMO_ENTRY;
+
+
+/** @var typedef struct pool_memo_t POOL_MEMO
+ *  @brief Recently resolved flow cell and index pairs, private to one parse thread.
  */
 
-KHASH_MAP_INIT_STR(pool, POOL*)
+typedef struct pool_memo_t
+{
+	POOL_MEMO_ENTRY entry[POOL_MEMO_SIZE];   /**< The remembered pairs. */
+	int n;                                   /**< The number of entries in use. */
+	int last;                                /**< The entry matched by the previous lookup. */
+	int next;                                /**< The entry to be replaced next. */
+} POOL_MEMO;
 
 /** @def KHASH_MAP_INIT_STR(pool_hash, khash_t(pool)*)
  *  @brief Defines the top-level hash
@@ -211,17 +672,65 @@ KHASH_MAP_INIT_STR(pool, POOL*)
 
 KHASH_MAP_INIT_STR(pool_hash, khash_t(pool)*)
 
-/** @def KHASH_MAP_INIT_STR(fastq, FASTQ*)
- *  @brief Defines the hash to hold fastQ entries
+/** @def KHASH_MAP_INIT_INT64(read_id, void*)
+ *  @brief Defines the hash of reads keyed by packed lane, tile and coordinates
+ */
+
+KHASH_MAP_INIT_INT64(read_id, void*)
+
+/** @def KHASH_MAP_INIT_STR(read_name, void*)
+ *  @brief Defines the hash of reads whose names cannot be packed
+ */
+
+KHASH_MAP_INIT_STR(read_name, void*)
+
+
+/** @def KHASH_MAP_INIT_STR(mate_name, uint32_t)
+ *  @brief Defines the hash of forward read sample indices whose names cannot be packed
+ */
+
+KHASH_MAP_INIT_STR(mate_name, uint32_t)
+
+
+/** @var typedef struct read_prefixes_t READ_PREFIXES
+ *  @brief The run and flow cell fields numbered in packed read keys.
+ */
+
+typedef struct read_prefixes_t
+{
+	char *prefix[MAX_READ_PREFIXES];  /**< The run and flow cell fields of each number. */
+	size_t len[MAX_READ_PREFIXES];    /**< Length of each run and flow cell prefix. */
+	int n;                            /**< The number of prefixes. */
+} READ_PREFIXES;
+
+
+/** @var typedef struct read_table_t READ_TABLE
+ *  @brief Hash of reads keyed by the mate-pair key of their Illumina identifier.
  */
 
-KHASH_MAP_INIT_STR(fastq, FASTQ*)
+typedef struct read_table_t
+{
+	khash_t(read_id) *ids;       /**< Reads whose keys pack into 64 bits. */
+	khash_t(read_name) *names;   /**< Reads keyed by the name string, for other identifiers. */
+	READ_PREFIXES rp;            /**< The run and flow cell prefixes numbered in packed keys. */
+} READ_TABLE;
+
 
-/** @def KHASH_MAP_INIT_STR(mates, char*)
- *  @brief Defines the hash to hold mate information
+/** @var typedef struct mate_table_t MATE_TABLE
+ *  @brief Open-addressing table from forward read keys to the index of their sample.
  */
 
-KHASH_MAP_INIT_STR(mates, char*)
+typedef struct mate_table_t
+{
+	uint64_t *keys;               /**< Packed read keys, or UINT64_MAX in an empty slot. */
+	uint32_t *vals;               /**< Sample index of each slot, stored after the keys in the same allocation. */
+	size_t cap;                   /**< The number of slots, a power of two. */
+	size_t n;                     /**< The number of occupied slots. */
+	READ_PREFIXES rp;             /**< The run and flow cell prefixes numbered in packed keys. */
+	khash_t(mate_name) *names;    /**< Sample indices keyed by the name string, for other identifiers. */
+	BARCODE **sample;             /**< The sample of each index. */
+	uint32_t nsamples;            /**< The number of samples. */
+} MATE_TABLE;
 
 
 /******************************************************
@@ -232,69 +741,206 @@ KHASH_MAP_INIT_STR(mates, char*)
  * Parsing functions
  ******************************************************/
 
-/** @fn int parse_fastq(const CMD *cp, const int orient, const char *filename, khash_t(pool_hash) *h, khash_t(mates) *m)
- *  @brief Parses a fastQ file by index sequence.
+/** @fn int parse_fastq(const CMD *cp, const int orient, const char *ffor, const char *frev, khash_t(pool_hash) *h, MATE_TABLE *m)
+ *  @brief Parses a fastQ file, or a pair of mate fastQ files in lockstep, by index sequence.
+ *  @param cp Pointer to command line data structure (read-only).
+ *  @param orient Orientation of reads in fastQ file, or PAIRED (read-only).
+ *  @param ffor Pointer to string holding fastQ input file name (read-only).
+ *  @param frev Pointer to string holding reverse fastQ input file name, only read if orient is PAIRED (read-only).
+ *  @param h Pointer to pool_hash hash table with parsing database.
+ *  @param m Pointer to mate table (unused if orient is PAIRED).
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int parse_fastq(const CMD *cp, const int orient, const char *ffor, const char *frev, khash_t(pool_hash) *h, MATE_TABLE *m);
+
+
+/** @fn int parse_fastq_mt(const CMD *cp, const int orient, BLOCK_READER *rd, khash_t(pool_hash) *h, MATE_TABLE *m)
+ *  @brief Parses blocks from an open reader with one reader and multiple parse threads.
  *  @param cp Pointer to command line data structure (read-only).
- *  @param orient Orientation of reads in fastQ file (read-only).
- *  @param filename Pointer to string holding fastQ input file name (read-only).
+ *  @param orient Orientation of reads in fastQ file, or PAIRED (read-only).
+ *  @param rd Pointer to the open input block reader.
  *  @param h Pointer to pool_hash hash table with parsing database.
- *  @param m Pointer to mate information hash table.
+ *  @param m Pointer to mate table.
  *  @return Zero on success and non-zero on failure.
  */
 
-extern int parse_fastq(const CMD *cp, const int orient, const char *filename, khash_t(pool_hash) *h, khash_t(mates) *m);
+extern int parse_fastq_mt(const CMD *cp, const int orient, BLOCK_READER *rd, khash_t(pool_hash) *h, MATE_TABLE *m);
 
 
-/** @fn int parse_forwardbuffer(const CMD *cp, char *buff, const size_t nl, khash_t(pool_hash) *h, khash_t(mates) *m)
+/** @fn int parse_forwardbuffer(const CMD *cp, char *buff, const size_t nl, const khash_t(pool_hash) *h, MATE_TABLE *m, POOL_MEMO *memo)
  *  @brief Parses forward fastQ entries in the buffer.
  *  @param cp Pointer to command line data structure (read-only).
  *  @param buff Pointer to string holding the buffer.
  *  @param nl Number of lines in the buffer (read-only).
  *  @param h Pointer to pool_hash hash table with parsing database (read-only).
- *  @param m Pointer to mate information hash table.
+ *  @param m Pointer to mate table, which records the sample of each entry.
+ *  @param memo Pointer to the calling thread's memo of resolved pools.
  *  @return Zero on success and non-zero on failure.
  */
 
-extern int parse_forwardbuffer(const CMD *cp, char *buff, const size_t nl, const khash_t(pool_hash) *h, khash_t(mates) *m);
+extern int parse_forwardbuffer(const CMD *cp, char *buff, const size_t nl, const khash_t(pool_hash) *h, MATE_TABLE *m,
+                               POOL_MEMO *memo);
 
 
-/** @fn int parse_reversebuffer(const CMD *cp, char *buff, const size_t nl, khash_t(pool_hash) *h, khash_t(mates) *m)
+/** @fn int parse_reversebuffer(const CMD *cp, char *buff, const size_t nl, const MATE_TABLE *m)
  *  @brief Parses reverse fastQ entries in the buffer.
  *  @param cp Pointer to command line data structure (read-only).
  *  @param buff Pointer to string holding the buffer.
  *  @param nl Number of lines in the buffer (read-only).
+ *  @param m Pointer to mate table filled by the forward pass (read-only).
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int parse_reversebuffer(const CMD *cp, char *buff, const size_t nl, const MATE_TABLE *m);
+
+
+/** @fn int parse_pairbuffer(const CMD *cp, char *fbuff, char *rbuff, const size_t nl, const khash_t(pool_hash) *h, POOL_MEMO *memo, ALIGN_WORK *aw)
+ *  @brief Parses mate-paired fastQ entries from forward and reverse buffers read in lockstep.
+ *  @param cp Pointer to command line data structure (read-only).
+ *  @param fbuff Pointer to string holding the forward buffer.
+ *  @param rbuff Pointer to string holding the reverse buffer.
+ *  @param nl Number of lines in each buffer (read-only).
  *  @param h Pointer to pool_hash hash table with parsing database (read-only).
- *  @param m Pointer to mate information hash table (read-only).
+ *  @param memo Pointer to the calling thread's memo of resolved pools.
+ *  @param aw Pointer to the calling thread's alignment buffers, for trimming fused runs.
  *  @return Zero on success and non-zero on failure.
  */
 
-extern int parse_reversebuffer(const CMD *cp, char *buff, const size_t nl, const khash_t(pool_hash) *h, const khash_t(mates) *m);
+extern int parse_pairbuffer(const CMD *cp, char *fbuff, char *rbuff, const size_t nl, const khash_t(pool_hash) *h,
+                            POOL_MEMO *memo, ALIGN_WORK *aw);
+
+
+/** @fn int lookup_barcode(const CMD *cp, const khash_t(pool_hash) *h, POOL_MEMO *memo, const FASTQ_VIEW *v, const ILLUMINA_ID *id, size_t *trim, BARCODE **bc)
+ *  @brief Finds the sample a forward fastQ entry belongs to.
+ *  @param cp Pointer to command line data structure (read-only).
+ *  @param h Pointer to pool_hash hash table with parsing database (read-only).
+ *  @param memo Pointer to the calling thread's memo of resolved pools.
+ *  @param v Pointer to view of the forward fastQ entry (read-only).
+ *  @param id Pointer to the parsed Illumina identifier of the entry (read-only).
+ *  @param trim Set to the barcode length of the entry's pool.
+ *  @param bc Set to the matching sample, or NULL if no barcode matches.
+ *  @return Zero on success and non-zero if the flow cell or index is not in the database.
+ */
+
+extern int lookup_barcode(const CMD *cp, const khash_t(pool_hash) *h, POOL_MEMO *memo, const FASTQ_VIEW *v, const ILLUMINA_ID *id, size_t *trim, BARCODE **bc);
+
+
+/** @fn POOL *find_pool(const khash_t(pool_hash) *h, POOL_MEMO *memo, const ILLUMINA_ID *id)
+ *  @brief Finds the sample pool of a fastQ entry from its flow cell and index sequence.
+ *  @param h Pointer to pool_hash hash table with parsing database (read-only).
+ *  @param memo Pointer to the calling thread's memo of resolved pools, or NULL.
+ *  @param id Pointer to the parsed Illumina identifier of the entry (read-only).
+ *  @return Pointer to the POOL data structure or NULL if it is not in the database.
+ */
+
+extern POOL *find_pool(const khash_t(pool_hash) *h, POOL_MEMO *memo, const ILLUMINA_ID *id);
+
+
+/** @fn uint64_t pack_dna(const char *s, const size_t len)
+ *  @brief Packs a DNA sequence two bits per base, with a mask of N positions, into an integer hash key.
+ *  @param s Pointer to the sequence (read-only).
+ *  @param len Length of the sequence.
+ *  @return The packed key, or a hash flagged with PACK_ESCAPE if the sequence is too long or not DNA.
+ */
+
+extern uint64_t pack_dna(const char *s, const size_t len);
+
+
+/** @fn char *tokenize_fastq(char *buff, FASTQ_VIEW *v)
+ *  @brief Tokenizes the next fastQ entry in a block of null-delimited lines without copying.
+ *  @param buff Pointer to the first line of the entry.
+ *  @param v Pointer to view filled in with the entry's lines.
+ *  @return Pointer to the first line of the next entry.
+ */
+
+extern char *tokenize_fastq(char *buff, FASTQ_VIEW *v);
+
+
+/** @fn int parse_idline(const char *idline, const size_t len, ILLUMINA_ID *id)
+ *  @brief Locates the mate key, flow cell and index fields of an Illumina identifier line.
+ *  @param idline Pointer to the identifier line (read-only).
+ *  @param len Length of the identifier line.
+ *  @param id Pointer to data structure filled in with the field locations.
+ *  @return Zero on success and non-zero if the line is malformed.
+ */
+
+extern int parse_idline(const char *idline, const size_t len, ILLUMINA_ID *id);
 
 
 /******************************************************
  * Sequence pairing functions
  ******************************************************/
 
-/** @fn int pair_mates(const char *filename, const khash_t(fastq) *h, const char *ffor, const char *frev, FILE *lf)
+/** @fn int pair_mates(const char *filename, const READ_TABLE *h, const char *ffor, const char *frev, BGZF_POOL *bp, FILE *lf)
  *  @brief Pairs mates in two fastQ files.
  *  @param filename Pointer to string for input forward fastQ (read-only).
  *  @param h Pointer to hash table to hold forward sequences (read only).
  *  @param ffor Pointer to string with forward output file name (read only).
  *  @param frev Pointer to string with reverse output file name (read only).
+ *  @param bp Pointer to the output compression threads.
+ *  @param lf Pointer to log file stream.
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int pair_mates(const char *filename, const READ_TABLE *h, const char *ffor, const char *frev,
+                      BGZF_POOL *bp, FILE *lf);
+
+
+/** @fn int merge_mates(const char *fin, const char *rin, const char *ffor, const char *frev, const int window, const size_t max_mem, BGZF_POOL *bp, FILE *lf)
+ *  @brief Pairs mates in two fastQ files by streaming both, holding only out-of-order entries in memory.
+ *  @param fin Pointer to string with forward input file name (read-only).
+ *  @param rin Pointer to string with reverse input file name (read-only).
+ *  @param ffor Pointer to string with forward output file name (read-only).
+ *  @param frev Pointer to string with reverse output file name (read-only).
+ *  @param window Number of forward entries read ahead to find the mate of a reverse entry.
+ *  @param max_mem Memory budget in bytes for entries held out of order, or zero for no limit.
+ *  @param bp Pointer to the output compression threads.
+ *  @param lf Pointer to log file stream.
+ *  @return Zero on success, MEM_EXCEEDED if the held entries would pass the budget,
+ *          and one on failure.
+ */
+
+extern int merge_mates(const char *fin, const char *rin, const char *ffor, const char *frev,
+                       const int window, const size_t max_mem, BGZF_POOL *bp, FILE *lf);
+
+
+/** @fn int sort_run_limit(const int nsamples, FILE *lf)
+ *  @brief Finds how many sorted runs of each file can be kept open within the descriptor limit.
+ *  @param nsamples Number of samples paired at once.
+ *  @param lf Pointer to log file stream.
+ *  @return The number of runs of one file, between 2 and MAX_MERGE_RUNS.
+ */
+
+extern int sort_run_limit(const int nsamples, FILE *lf);
+
+
+/** @fn int sort_mates(const char *fin, const char *rin, const char *ffor, const char *frev, const size_t max_mem, const int max_runs, BGZF_POOL *bp, FILE *lf)
+ *  @brief Pairs mates in bounded memory by spilling sorted runs of both files and merging them.
+ *  @param fin Pointer to string with forward input file name (read-only).
+ *  @param rin Pointer to string with reverse input file name (read-only).
+ *  @param ffor Pointer to string with forward output file name (read-only).
+ *  @param frev Pointer to string with reverse output file name (read-only).
+ *  @param max_mem Memory budget in bytes for the entries held in one run.
+ *  @param max_runs Number of runs of each file kept open before they are merged into one.
+ *  @param bp Pointer to the output compression threads.
  *  @param lf Pointer to log file stream.
  *  @return Zero on success and non-zero on failure.
  */
 
-extern int pair_mates(const char *filename, const khash_t(fastq) *h, const char *ffor, const char *frev, FILE *lf);
+extern int sort_mates(const char *fin, const char *rin, const char *ffor, const char *frev,
+                      const size_t max_mem, const int max_runs, BGZF_POOL *bp, FILE *lf);
 
 
 /******************************************************
  * Trimend functions
  ******************************************************/
 
-/** @fn int align_mates(const CMD *cp, const char *fin, const char *rin, const char *fout, const char *rout)
+/** @fn int align_mates(const CMD *cp, BGZF_POOL *bp, ALIGN_SLOTS *as, const char *fin, const char *rin, const char *fout, const char *rout)
  *  @brief Align mates in two fastQ files and trim 3' end of reverse sequences.
  *  @param cp Pointer to command line data structure (read-only).
+ *  @param bp Pointer to the output compression threads.
+ *  @param as Pointer to the alignment threads shared with the other samples.
  *  @param fin Pointer to string with forward input file name (read-only).
  *  @param rin Pointer to string with reverse input file name (read-only).
  *  @param fout Pointer to string with forward output file name (read-only).
@@ -302,9 +948,39 @@ extern int pair_mates(const char *filename, const khash_t(fastq) *h, const char
  *  @return Zero on success and non-zero on failure.
  */
 
-extern int align_mates(const CMD *cp, const char *fin, const char *rin, const char *fout, const char *rout);
+extern int align_mates(const CMD *cp, BGZF_POOL *bp, ALIGN_SLOTS *as, const char *fin, const char *rin,
+                       const char *fout, const char *rout);
+
+
+/** @fn int trim_mate(const CMD *cp, const char *fseq, const size_t flen, const char *rseq, size_t *rlen, ALIGN_WORK *w)
+ *  @brief Aligns a pair of mates and finds where to trim the 3' end of the reverse sequence.
+ *  @param cp Pointer to command line data structure (read-only).
+ *  @param fseq Pointer to the forward DNA sequence (read-only).
+ *  @param flen Length of the forward DNA sequence.
+ *  @param rseq Pointer to the reverse DNA sequence, ended by a newline or null (read-only).
+ *  @param rlen Pointer to the length the reverse sequence should be trimmed to.
+ *  @param w Pointer to the calling thread's alignment buffers.
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int trim_mate(const CMD *cp, const char *fseq, const size_t flen, const char *rseq,
+                     size_t *rlen, ALIGN_WORK *w);
 
 
+/** @fn int trim_mates(const CMD *cp, FASTQ_VIEW **fv, FASTQ_VIEW **rv, const int n, size_t *rlen, ALIGN_WORK *w)
+ *  @brief Aligns up to ALIGN_LANES pairs of mates together and finds where to trim each reverse sequence.
+ *  @param cp Pointer to command line data structure (read-only).
+ *  @param fv Array of views of the forward mates.
+ *  @param rv Array of views of the reverse mates.
+ *  @param n The number of mate pairs.
+ *  @param rlen Array set to the length each reverse sequence is trimmed to.
+ *  @param w Pointer to the calling thread's alignment buffers.
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int trim_mates(const CMD *cp, FASTQ_VIEW **fv, FASTQ_VIEW **rv, const int n,
+                      size_t *rlen, ALIGN_WORK *w);
+
 /******************************************************
  * UI functions
  ******************************************************/
@@ -341,14 +1017,19 @@ extern khash_t(pool_hash) *read_csv(const CMD *cp);
 extern int check_csv(const CMD *cp);
 
 
-/** @fn khash_t(fastq)* fastq_to_db(const char *filename, FILE *lf)
+/** @fn int fastq_to_db(const char *filename, const size_t max_mem, ARENA *ar, READ_TABLE **hp, FILE *lf)
  *  @brief Populates a fastQ database from fastQ input file.
  *  @param filename Pointer to string holding input fastQ file name (read-only).
+ *  @param max_mem Memory budget in bytes for the database, or zero for no limit.
+ *  @param ar Pointer to the arena that holds the database entries.
+ *  @param hp Address of the pointer to set to the populated fastQ hash table.
  *  @param lf Pointer to log file stream.
- *  @return Pointer to fastQ hash table on success or NULL on failure.
+ *  @return Zero on success, MEM_EXCEEDED if the database would pass the budget,
+ *          and one on failure.
  */
 
-extern khash_t(fastq) *fastq_to_db(const char *filename, FILE *lf);
+extern int fastq_to_db(const char *filename, const size_t max_mem, ARENA *ar,
+                       READ_TABLE **hp, FILE *lf);
 
 
 /******************************************************
@@ -380,33 +1061,134 @@ extern unsigned int traverse_dirtree(const CMD *cp, const char *caller, char ***
  * Buffer management functions
  ******************************************************/
 
-/** @fn char *clean_buffer(char *buff, size_t *nl)
- *  @brief Limits the buffer to hold only entire fastQ entries.
- *  @param buff Pointer to the string holding the buffer.
- *  @param nl Number of new line characters in the buffer.
- *  @return Pointer to new end of buffer.
+/** @fn BLOCK_READER *reader_open(const char *ffor, const char *frev, FILE *lf)
+ *  @brief Opens a fastQ file, or a pair of mate fastQ files, for block reading.
+ *  @param ffor Pointer to string holding the forward input file name (read-only).
+ *  @param frev Pointer to string holding the reverse input file name, or NULL (read-only).
+ *  @param lf Pointer to log file stream.
+ *  @return Pointer to the new reader on success or NULL on failure.
  */
 
-extern char *clean_buffer(char *buff, size_t *nl);
+extern BLOCK_READER *reader_open(const char *ffor, const char *frev, FILE *lf);
 
 
-/** @fn size_t reset_buffer(char *buff, const char *r)
- *  @brief Resets the buffer for next read block.
- *  @param buff Pointer to the string holding the buffer.
- *  @param r Pointer to new end of buffer (read-only).
- *  @return The number of leftover characters in the old buffer.
+/** @fn int read_block(BLOCK_READER *rd, PARSE_BLOCK *pb, FILE *lf)
+ *  @brief Fills a block with whole fastQ entries, holding the same number of entries from each file when reading mates.
+ *  @param rd Pointer to the block reader.
+ *  @param pb Pointer to the block to fill.
+ *  @param lf Pointer to log file stream.
+ *  @return One if the block holds entries, zero at end of input and negative on failure.
  */
 
-extern size_t reset_buffer(char *buff, const char *r);
+extern int read_block(BLOCK_READER *rd, PARSE_BLOCK *pb, FILE *lf);
 
 
-/** @fn size_t reset_buffer(char *buff, const char *r)
- *  @brief Counts newline characters in buffer.
- *  @param buff Pointer to the string holding the buffer (read-only).
- *  @return The number of newline characters in the buffer.
+/** @fn void reader_close(BLOCK_READER *rd)
+ *  @brief Closes the input streams and deallocates the block reader.
+ *  @param rd Pointer to the block reader.
  */
 
-extern size_t count_lines(const char *buff);
+extern void reader_close(BLOCK_READER *rd);
+
+
+/** @fn FASTQ_READER *fqreader_open(const char *filename, FILE *lf)
+ *  @brief Opens a fastQ file for reading one entry at a time.
+ *  @param filename Pointer to string holding the input file name (read-only).
+ *  @param lf Pointer to log file stream.
+ *  @return Pointer to the new reader on success or NULL on failure.
+ */
+
+extern FASTQ_READER *fqreader_open(const char *filename, FILE *lf);
+
+
+/** @fn FASTQ_READER *fqreader_dopen(const int fd, const char *name, const size_t size, FILE *lf)
+ *  @brief Reads fastQ entries from an open file descriptor, which the reader then owns.
+ *  @param fd The file descriptor (read-only).
+ *  @param name Pointer to string naming the file in log messages (read-only).
+ *  @param size Initial size of the decompressed block (read-only).
+ *  @param lf Pointer to log file stream.
+ *  @return Pointer to the new reader on success or NULL on failure.
+ */
+
+extern FASTQ_READER *fqreader_dopen(const int fd, const char *name, const size_t size, FILE *lf);
+
+
+/** @fn int fqreader_next(FASTQ_READER *fr, FASTQ_VIEW *v)
+ *  @brief Gets the next fastQ entry; its lines are null-terminated and stay valid until the next call.
+ *  @param fr Pointer to the fastQ reader.
+ *  @param v Set to view of the entry.
+ *  @return One for an entry, zero at the end of the file, and negative on failure.
+ */
+
+extern int fqreader_next(FASTQ_READER *fr, FASTQ_VIEW *v);
+
+
+/** @fn void fqreader_close(FASTQ_READER *fr)
+ *  @brief Closes the input stream and deallocates the fastQ reader.
+ *  @param fr Pointer to the fastQ reader.
+ */
+
+extern void fqreader_close(FASTQ_READER *fr);
+
+
+/** @fn const char *fastq_key(const FASTQ_VIEW *v, size_t *len)
+ *  @brief Finds the mate-pair key of a fastQ entry, from the first colon to the first space of its identifier.
+ *  @param v Pointer to view of the fastQ entry (read-only).
+ *  @param len Set to the length of the key.
+ *  @return Pointer to the start of the key or NULL if the identifier is malformed.
+ */
+
+extern const char *fastq_key(const FASTQ_VIEW *v, size_t *len);
+
+
+/** @fn char *clean_buffer(char *buff, size_t *nl)
+ *  @brief Limits the buffer to hold only entire fastQ entries.
+ *  @param buff Pointer to the string holding the buffer.
+ *  @param nl Number of new line characters in the buffer.
+ *  @return Pointer to new end of buffer.
+ */
+
+extern char *clean_buffer(char *buff, size_t *nl);
+
+
+/** @fn size_t reset_buffer(char *buff, const char *r)
+ *  @brief Resets the buffer for next read block.
+ *  @param buff Pointer to the string holding the buffer.
+ *  @param r Pointer to new end of buffer (read-only).
+ *  @return The number of leftover characters in the old buffer.
+ */
+
+extern size_t reset_buffer(char *buff, const char *r);
+
+
+/** @fn size_t reset_buffer(char *buff, const char *r)
+ *  @brief Counts newline characters in buffer.
+ *  @param buff Pointer to the string holding the buffer (read-only).
+ *  @return The number of newline characters in the buffer.
+ */
+
+extern size_t count_lines(const char *buff);
+
+
+/** @fn size_t append_fastq(char *buff, const FASTQ_VIEW *v, const size_t trim)
+ *  @brief Copies a fastQ entry into an output buffer.
+ *  @param buff Pointer to the position in the output buffer to write to.
+ *  @param v Pointer to view of the fastQ entry (read-only).
+ *  @param trim Number of leading bases to trim from the sequence and quality lines.
+ *  @return The number of bytes written.
+ */
+
+extern size_t append_fastq(char *buff, const FASTQ_VIEW *v, const size_t trim);
+
+
+/** @fn FASTQ_VIEW *copy_fastq(void *mem, const FASTQ_VIEW *v)
+ *  @brief Copies a fastQ entry to be held, laying out its view and null-terminated lines together.
+ *  @param mem Pointer to at least FASTQ_SIZE(v) bytes of memory.
+ *  @param v Pointer to view of the fastQ entry (read-only).
+ *  @return Pointer to the view of the copy, at the start of the memory.
+ */
+
+extern FASTQ_VIEW *copy_fastq(void *mem, const FASTQ_VIEW *v);
 
 
 /** @fn int flush_buffer(int orient, BARCODE *bc)
@@ -420,6 +1202,439 @@ extern size_t count_lines(const char *buff);
 extern int flush_buffer(int orient, BARCODE *bc, FILE *lf);
 
 
+/** @fn STREAM_CACHE *stream_cache_init(FILE *lf)
+ *  @brief Creates a cache of open output streams sized below the open file limit.
+ *  @param lf Pointer to log file stream.
+ *  @return Pointer to the new cache on success or NULL on failure.
+ */
+
+extern STREAM_CACHE *stream_cache_init(FILE *lf);
+
+
+/** @fn BGZF *stream_acquire(STREAM_CACHE *sc, OUT_STREAM *os, FILE *lf)
+ *  @brief Opens an output stream if needed, closing the least recently used idle stream to make room.
+ *  @param sc Pointer to the stream cache.
+ *  @param os Pointer to the output stream.
+ *  @param lf Pointer to log file stream.
+ *  @return The open stream, marked busy until released, or NULL on failure.
+ */
+
+extern BGZF *stream_acquire(STREAM_CACHE *sc, OUT_STREAM *os, FILE *lf);
+
+
+/** @fn void stream_release(STREAM_CACHE *sc, OUT_STREAM *os)
+ *  @brief Marks an output stream as no longer being written.
+ *  @param sc Pointer to the stream cache.
+ *  @param os Pointer to the output stream.
+ */
+
+extern void stream_release(STREAM_CACHE *sc, OUT_STREAM *os);
+
+
+/** @fn int stream_close(STREAM_CACHE *sc, OUT_STREAM *os, FILE *lf)
+ *  @brief Closes an output stream if it is open.
+ *  @param sc Pointer to the stream cache.
+ *  @param os Pointer to the output stream.
+ *  @param lf Pointer to log file stream.
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int stream_close(STREAM_CACHE *sc, OUT_STREAM *os, FILE *lf);
+
+
+/** @fn void stream_cache_destroy(STREAM_CACHE *sc)
+ *  @brief Deallocates memory used by the stream cache.
+ *  @param sc Pointer to the stream cache.
+ */
+
+extern void stream_cache_destroy(STREAM_CACHE *sc);
+
+
+/** @fn int flush_db(const int orient, khash_t(pool_hash) *h, FILE *lf)
+ *  @brief Dumps all non-empty sample buffers in the database to file and closes the output streams.
+ *  @param orient Orientation of reads in the buffers, or PAIRED for both buffers.
+ *  @param h Pointer to pool_hash hash table with parsing database.
+ *  @param lf Pointer to log file stream.
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int flush_db(const int orient, khash_t(pool_hash) *h, FILE *lf);
+
+
+/******************************************************
+ * Concurrency functions
+ ******************************************************/
+
+/** @fn WORK_QUEUE *queue_init(const int size)
+ *  @brief Creates a bounded work queue.
+ *  @param size Maximum number of items held by the queue.
+ *  @return Pointer to the new queue on success or NULL on failure.
+ */
+
+extern WORK_QUEUE *queue_init(const int size);
+
+
+/** @fn int queue_push(WORK_QUEUE *wq, void *item)
+ *  @brief Adds an item to the queue, blocking while the queue is full.
+ *  @param wq Pointer to the work queue.
+ *  @param item Pointer to the work item.
+ *  @return Zero on success and non-zero if the queue has been closed.
+ */
+
+extern int queue_push(WORK_QUEUE *wq, void *item);
+
+
+/** @fn void *queue_pop(WORK_QUEUE *wq)
+ *  @brief Removes an item from the queue, blocking while the queue is empty.
+ *  @param wq Pointer to the work queue.
+ *  @return Pointer to the work item or NULL once the queue is closed and drained.
+ */
+
+extern void *queue_pop(WORK_QUEUE *wq);
+
+
+/** @fn void queue_close(WORK_QUEUE *wq)
+ *  @brief Signals that no more items will be added to the queue.
+ *  @param wq Pointer to the work queue.
+ */
+
+extern void queue_close(WORK_QUEUE *wq);
+
+
+/** @fn void queue_destroy(WORK_QUEUE *wq)
+ *  @brief Deallocates memory used by the work queue.
+ *  @param wq Pointer to the work queue.
+ */
+
+extern void queue_destroy(WORK_QUEUE *wq);
+
+
+/** @fn ALIGN_SLOTS *align_slots_init(const int nslots, const int nsamples, const int nworkers)
+ *  @brief Creates a budget of alignment threads.
+ *  @param nslots Number of alignment threads running at once across all samples.
+ *  @param nsamples Number of samples to be aligned.
+ *  @param nworkers Number of samples aligned at once.
+ *  @return Pointer to the new budget on success or NULL on failure.
+ */
+
+extern ALIGN_SLOTS *align_slots_init(const int nslots, const int nsamples, const int nworkers);
+
+
+/** @fn int align_slots_take(ALIGN_SLOTS *as)
+ *  @brief Takes the alignment threads a sample starts with.
+ *  @param as Pointer to the alignment thread budget.
+ *  @return The number of threads taken, at least one.
+ */
+
+extern int align_slots_take(ALIGN_SLOTS *as);
+
+
+/** @fn int align_slots_grow(ALIGN_SLOTS *as, const int max)
+ *  @brief Takes threads left free by finished samples once every sample has started.
+ *  @param as Pointer to the alignment thread budget.
+ *  @param max Largest number of threads to take.
+ *  @return The number of threads taken, possibly zero.
+ */
+
+extern int align_slots_grow(ALIGN_SLOTS *as, const int max);
+
+
+/** @fn void align_slots_release(ALIGN_SLOTS *as, const int n)
+ *  @brief Gives back the alignment threads of a finished sample.
+ *  @param as Pointer to the alignment thread budget.
+ *  @param n Number of threads given back.
+ */
+
+extern void align_slots_release(ALIGN_SLOTS *as, const int n);
+
+
+/** @fn void align_slots_destroy(ALIGN_SLOTS *as)
+ *  @brief Deallocates memory used by the alignment thread budget.
+ *  @param as Pointer to the alignment thread budget.
+ */
+
+extern void align_slots_destroy(ALIGN_SLOTS *as);
+
+
+/** @fn int sample_workers(const CMD *cp, const unsigned int nfiles)
+ *  @brief Gives the number of samples processed at once by run_samples.
+ *  @param cp Pointer to command line data structure (read-only).
+ *  @param nfiles Number of input files, two for each sample (read-only).
+ *  @return The number of worker threads.
+ */
+
+extern int sample_workers(const CMD *cp, const unsigned int nfiles);
+
+
+/** @fn int run_samples(const CMD *cp, BGZF_POOL *bp, char **filelist, const unsigned int nfiles, SAMPLE_FUNC fn, void *arg)
+ *  @brief Processes every sample mate pair with a pool of threads, starting with the largest input files.
+ *  @param cp Pointer to command line data structure (read-only).
+ *  @param bp Pointer to the compression thread pool shared by all samples.
+ *  @param filelist Array of input file names, the forward file of each sample followed by its reverse file.
+ *  @param nfiles Number of input files (read-only).
+ *  @param fn Function called for each sample.
+ *  @param arg Pointer passed to every call of fn.
+ *  @return Zero on success and non-zero if any sample failed.
+ */
+
+extern int run_samples(const CMD *cp, BGZF_POOL *bp, char **filelist, const unsigned int nfiles,
+                       SAMPLE_FUNC fn, void *arg);
+
+
+/******************************************************
+ * Arena functions
+ ******************************************************/
+
+/** @fn ARENA *arena_init(void)
+ *  @brief Creates an empty arena.
+ *  @return Pointer to the new arena on success or NULL on failure.
+ */
+
+extern ARENA *arena_init(void);
+
+
+/** @fn void *arena_alloc(ARENA *ar, size_t len)
+ *  @brief Hands out memory from the arena's current block, starting a new block when it is full.
+ *  @param ar Pointer to the arena.
+ *  @param len Number of bytes needed.
+ *  @return Pointer to the memory on success or NULL on failure.
+ */
+
+extern void *arena_alloc(ARENA *ar, size_t len);
+
+
+/** @fn void arena_destroy(ARENA *ar)
+ *  @brief Frees the arena and every record allocated from it.
+ *  @param ar Pointer to the arena.
+ */
+
+extern void arena_destroy(ARENA *ar);
+
+
+/******************************************************
+ * Read table functions
+ ******************************************************/
+
+/** @fn READ_TABLE *readtab_init(void)
+ *  @brief Creates an empty read table.
+ *  @return Pointer to the new table on success or NULL on failure.
+ */
+
+extern READ_TABLE *readtab_init(void);
+
+
+/** @fn void **readtab_put(READ_TABLE *rt, const char *key, const size_t len, int *absent)
+ *  @brief Finds or adds the slot for a read, packing Illumina keys into 64-bit integers.
+ *  @param rt Pointer to the read table.
+ *  @param key Pointer to the mate-pair key (read-only, need not be null-terminated).
+ *  @param len Length of the mate-pair key.
+ *  @param absent Set to non-zero if the read was added, in which case the slot holds NULL.
+ *  @return Pointer to the value slot of the read on success or NULL on failure.
+ */
+
+extern void **readtab_put(READ_TABLE *rt, const char *key, const size_t len, int *absent);
+
+
+/** @fn void **readtab_get(const READ_TABLE *rt, const char *key, const size_t len)
+ *  @brief Finds the slot for a read.
+ *  @param rt Pointer to the read table (read-only).
+ *  @param key Pointer to the mate-pair key (read-only, need not be null-terminated).
+ *  @param len Length of the mate-pair key.
+ *  @return Pointer to the value slot of the read or NULL if it is not in the table.
+ */
+
+extern void **readtab_get(const READ_TABLE *rt, const char *key, const size_t len);
+
+
+/** @fn void readtab_del(READ_TABLE *rt, const char *key, const size_t len)
+ *  @brief Removes a read from the table, leaving its value to the caller.
+ *  @param rt Pointer to the read table.
+ *  @param key Pointer to the mate-pair key (read-only, need not be null-terminated).
+ *  @param len Length of the mate-pair key.
+ */
+
+extern void readtab_del(READ_TABLE *rt, const char *key, const size_t len);
+
+
+/** @fn size_t readtab_size(const READ_TABLE *rt)
+ *  @brief Counts the reads in the table.
+ *  @param rt Pointer to the read table (read-only).
+ *  @return The number of reads.
+ */
+
+extern size_t readtab_size(const READ_TABLE *rt);
+
+
+/** @fn size_t readtab_bytes(const READ_TABLE *rt)
+ *  @brief Estimates the memory used by the table's slots.
+ *  @param rt Pointer to the read table (read-only).
+ *  @return The number of bytes.
+ */
+
+extern size_t readtab_bytes(const READ_TABLE *rt);
+
+
+/** @fn void readtab_destroy(READ_TABLE *rt)
+ *  @brief Deallocates the read table, leaving the values to the caller.
+ *  @param rt Pointer to the read table.
+ */
+
+extern void readtab_destroy(READ_TABLE *rt);
+
+
+/** @fn int pack_readkey(const READ_PREFIXES *rp, const char *key, const size_t len, uint64_t *packed)
+ *  @brief Packs the mate-pair key of an Illumina identifier into 64 bits.
+ *  @param rp Pointer to the numbered run and flow cell prefixes (read-only).
+ *  @param key Pointer to the key, which need not be null-terminated (read-only).
+ *  @param len Length of the key (read-only).
+ *  @param packed Set to the packed key on success.
+ *  @return Zero on success, PREFIX_UNKNOWN if the run and flow cell are not numbered, or one if the key cannot be packed.
+ */
+
+extern int pack_readkey(const READ_PREFIXES *rp, const char *key, const size_t len, uint64_t *packed);
+
+
+/** @fn int add_readprefix(READ_PREFIXES *rp, const char *key, const size_t len)
+ *  @brief Numbers the run and flow cell prefix of a read key.
+ *  @param rp Pointer to the numbered run and flow cell prefixes.
+ *  @param key Pointer to the key, which need not be null-terminated (read-only).
+ *  @param len Length of the key (read-only).
+ *  @return Zero on success and non-zero if the key cannot be packed or every number is taken.
+ */
+
+extern int add_readprefix(READ_PREFIXES *rp, const char *key, const size_t len);
+
+
+/******************************************************
+ * Mate table functions
+ ******************************************************/
+
+/** @fn MATE_TABLE *mate_table_init(const khash_t(pool_hash) *h)
+ *  @brief Creates an empty mate table and numbers every sample in the database.
+ *  @param h Pointer to pool_hash hash table with parsing database (read-only).
+ *  @return Pointer to the new table on success or NULL on failure.
+ */
+
+extern MATE_TABLE *mate_table_init(const khash_t(pool_hash) *h);
+
+
+/** @fn int mate_table_put(MATE_TABLE *mt, const char *key, const size_t len, const uint32_t idx)
+ *  @brief Records the sample index of a forward read; the first entry of a repeated key is kept.
+ *  @param mt Pointer to the mate table.
+ *  @param key Pointer to the read key, which need not be null-terminated (read-only).
+ *  @param len Length of the key (read-only).
+ *  @param idx Index of the sample, or MATE_SKIPPED (read-only).
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int mate_table_put(MATE_TABLE *mt, const char *key, const size_t len, const uint32_t idx);
+
+
+/** @fn int mate_table_get(const MATE_TABLE *mt, const char *key, const size_t len, uint32_t *idx)
+ *  @brief Finds the sample index of a read's forward mate.
+ *  @param mt Pointer to the mate table (read-only).
+ *  @param key Pointer to the read key, which need not be null-terminated (read-only).
+ *  @param len Length of the key (read-only).
+ *  @param idx Set to the sample index if the key is found.
+ *  @return Zero if the key is found and non-zero otherwise.
+ */
+
+extern int mate_table_get(const MATE_TABLE *mt, const char *key, const size_t len, uint32_t *idx);
+
+
+/** @fn void mate_table_destroy(MATE_TABLE *mt)
+ *  @brief Frees the mate table.
+ *  @param mt Pointer to the mate table.
+ */
+
+extern void mate_table_destroy(MATE_TABLE *mt);
+
+
+/******************************************************
+ * Compressed output functions
+ ******************************************************/
+
+/** @fn BGZF_POOL *bgzf_pool_init(const int nthreads, const int nwriters, FILE *lf)
+ *  @brief Starts the threads that compress blocks for BGZF writers.
+ *  @param nthreads Number of compression threads.
+ *  @param nwriters Number of writers open at once, which share the blocks in flight.
+ *  @param lf Pointer to log file stream.
+ *  @return Pointer to the new pool on success or NULL on failure.
+ */
+
+extern BGZF_POOL *bgzf_pool_init(const int nthreads, const int nwriters, FILE *lf);
+
+
+/** @fn void bgzf_pool_destroy(BGZF_POOL *bp)
+ *  @brief Stops the compression threads once every writer using them is closed.
+ *  @param bp Pointer to the compression pool.
+ */
+
+extern void bgzf_pool_destroy(BGZF_POOL *bp);
+
+
+/** @fn BGZF *bgzf_open(const char *filename, BGZF_POOL *bp, FILE *lf)
+ *  @brief Creates or truncates a file for BGZF output.
+ *  @param filename Pointer to string with output file name, kept for log messages.
+ *  @param bp Pointer to the compression pool, or NULL to compress in the writing thread.
+ *  @param lf Pointer to log file stream.
+ *  @return Pointer to the new writer or NULL with errno set on failure.
+ */
+
+extern BGZF *bgzf_open(const char *filename, BGZF_POOL *bp, FILE *lf);
+
+
+/** @fn BGZF *bgzf_dopen(const int fd, const char *filename, BGZF_POOL *bp, FILE *lf)
+ *  @brief Starts BGZF output on an open file descriptor, which is closed with the writer.
+ *  @param fd The output file descriptor.
+ *  @param filename Pointer to string with output file name, kept for log messages.
+ *  @param bp Pointer to the compression pool, or NULL to compress in the writing thread.
+ *  @param lf Pointer to log file stream.
+ *  @return Pointer to the new writer on success or NULL on failure.
+ */
+
+extern BGZF *bgzf_dopen(const int fd, const char *filename, BGZF_POOL *bp, FILE *lf);
+
+
+/** @fn int bgzf_write(BGZF *fp, const void *data, size_t len)
+ *  @brief Appends data to the output, handing each full block to be compressed.
+ *  @param fp Pointer to the BGZF writer.
+ *  @param data Pointer to the data (read-only).
+ *  @param len Number of bytes to write.
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int bgzf_write(BGZF *fp, const void *data, size_t len);
+
+
+/** @fn int bgzf_write_fastq(BGZF *fp, const FASTQ_VIEW *v)
+ *  @brief Appends a fastQ entry to the output, copying it straight into the current block.
+ *  @param fp Pointer to the BGZF writer.
+ *  @param v Pointer to view of the fastQ entry (read-only).
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int bgzf_write_fastq(BGZF *fp, const FASTQ_VIEW *v);
+
+
+/** @fn int bgzf_flush(BGZF *fp)
+ *  @brief Compresses any partial block and writes every pending block to the file.
+ *  @param fp Pointer to the BGZF writer.
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int bgzf_flush(BGZF *fp);
+
+
+/** @fn int bgzf_close(BGZF *fp)
+ *  @brief Flushes the writer, appends the end-of-file block and closes the file.
+ *  @param fp Pointer to the BGZF writer.
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int bgzf_close(BGZF *fp);
+
+
 /******************************************************
  * Memory management functions
  ******************************************************/
@@ -442,29 +1657,30 @@ extern int destroy_cmdline(CMD *cp);
 extern int free_db(khash_t(pool_hash) *h);
 
 
-/** @fn int free_pairdb (khash_t(fastq) *h)
+/** @fn int free_pairdb(READ_TABLE *h, ARENA *ar)
  *  @brief Deallocates memory used by forward fastQ database.
- *  @param h Pointer to hash table to hold forward sequences.0
+ *  @param h Pointer to hash table to hold forward sequences.
+ *  @param ar Pointer to the arena holding the entries, or NULL if each was allocated separately.
  *  @return Zero on success and non-zero on failure.
  */
 
-extern int free_pairdb(khash_t(fastq) *h);
+extern int free_pairdb(READ_TABLE *h, ARENA *ar);
 
 
-/** @fn int free_matedb(khash_t(mates) *m)
+/** @fn int free_matedb(MATE_TABLE *m)
  *  @brief Deallocates memory used by mate pair database.
- *  @param m Pointer to mate information hash table.
+ *  @param m Pointer to mate table.
  *  @return Zero on success and non-zero on failure.
  */
 
-extern int free_matedb(khash_t(mates) *m);
+extern int free_matedb(MATE_TABLE *m);
 
 
 /******************************************************
  * Alignment functions
  ******************************************************/
 
-/** @fn ALIGN_RESULT local_align(int qlen, char *query, int tlen, char *target, const char *mat, int gapo, int gape, int xtra, FILE *lf)
+/** @fn ALIGN_RESULT local_align(int qlen, char *query, int tlen, char *target, const char *mat, int gapo, int gape, int xtra, ALIGN_WORK *w, FILE *lf)
  *  @brief Calculates the local sequence alignment by Smith-Waterman algorithm.
  *  @param qlen Length of query sequence.
  *  @param query Pointer string holding query sequence.
@@ -474,11 +1690,102 @@ extern int free_matedb(khash_t(mates) *m);
  *  @param gapo Gap penalty.
  *  @param gape Gap extension penalty.
  *  @param xtra Status variable.
+ *  @param w Pointer to the calling thread's alignment buffers.
  *  @param lf Pointer to log file stream.
  *  @return ALIGN_RESULT data structure on success
  */
 
-extern ALIGN_RESULT local_align(int qlen, char *query, int tlen, char *target, const char *mat, int gapo, int gape, int xtra, FILE *lf);
+extern ALIGN_RESULT local_align(int qlen, char *query, int tlen, char *target, const char *mat, int gapo, int gape, int xtra, ALIGN_WORK *w, FILE *lf);
+
+
+/** @fn int align_batch(ALIGN_BATCH *ab, const int sa, const int sb, const int gapo, const int gape, ALIGN_WORK *w, FILE *lf)
+ *  @brief Finds the best local alignment of each pair in a batch, as local_align does without KSW_XSTART;
+ *         query ends are only found for scores of at least minsc.
+ *  @param ab Pointer to the batch of sequence pairs.
+ *  @param sa Score of a matching base.
+ *  @param sb Penalty for a mismatched base.
+ *  @param gapo Gap penalty.
+ *  @param gape Gap extension penalty.
+ *  @param w Pointer to the calling thread's alignment buffers.
+ *  @param lf Pointer to log file stream.
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int align_batch(ALIGN_BATCH *ab, const int sa, const int sb, const int gapo, const int gape,
+                       ALIGN_WORK *w, FILE *lf);
+
+
+/** @fn void align_batch_init(FILE *lf)
+ *  @brief Chooses the widest batched alignment kernel the processor runs.
+ *  @param lf Pointer to log file stream.
+ */
+
+extern void align_batch_init(FILE *lf);
+
+
+/** @fn void *grow_buffer(void **p, size_t *size, const size_t need)
+ *  @brief Makes a reusable buffer hold at least need bytes, keeping its contents.
+ *  @param p Pointer to the buffer, which may be NULL.
+ *  @param size Pointer to the number of bytes the buffer holds.
+ *  @param need Number of bytes needed.
+ *  @return Pointer to the buffer on success and NULL on failure.
+ */
+
+extern void *grow_buffer(void **p, size_t *size, const size_t need);
+
+
+/** @fn void align_work_free(ALIGN_WORK *w)
+ *  @brief Deallocates the buffers of a thread's alignment workspace.
+ *  @param w Pointer to the alignment workspace.
+ */
+
+extern void align_work_free(ALIGN_WORK *w);
+
+
+/** @fn int overlap_align(const char *query, const int qlen, const char *target, const int tlen, int dlo, int dhi, const int minsc, const int sa, const int sb, const int gapo, const int gape, ALIGN_RESULT *r, ALIGN_WORK *w, FILE *lf)
+ *  @brief Aligns the start of the target to the end of the query in a band of diagonals,
+ *         finding the query position facing the first target base in one pass.
+ *  @param query Query sequence, coded 0-4.
+ *  @param qlen Length of query sequence.
+ *  @param target Target sequence, coded 0-4.
+ *  @param tlen Length of the target sequence.
+ *  @param dlo Lowest query position the alignment may start from.
+ *  @param dhi Highest query position the alignment may start from.
+ *  @param minsc Lowest alignment score of interest, which sets the width of the band.
+ *  @param sa Score of a matching base.
+ *  @param sb Penalty for a mismatched base.
+ *  @param gapo Gap penalty.
+ *  @param gape Gap extension penalty.
+ *  @param r Pointer to the result, whose query_begin holds the start of the best alignment.
+ *  @param w Pointer to the calling thread's alignment buffers.
+ *  @param lf Pointer to log file stream.
+ *  @return Zero on success and non-zero on failure.
+ */
+
+extern int overlap_align(const char *query, const int qlen, const char *target, const int tlen,
+                         int dlo, int dhi, const int minsc, const int sa, const int sb,
+                         const int gapo, const int gape, ALIGN_RESULT *r, ALIGN_WORK *w,
+                         FILE *lf);
+
+
+/** @fn int seed_filter(const char *query, const int qlen, const char *target, const int tlen, const int minsc, const int sa, const int sb, const int gapo, const int gape)
+ *  @brief Checks whether two sequences share enough exact seeds for any local alignment of
+ *         them to score minsc.
+ *  @param query Query sequence, coded 0-4.
+ *  @param qlen Length of query sequence.
+ *  @param target Target sequence, coded 0-4.
+ *  @param tlen Length of the target sequence.
+ *  @param minsc Lowest alignment score of interest.
+ *  @param sa Score of a matching base.
+ *  @param sb Penalty for a mismatched base.
+ *  @param gapo Gap penalty.
+ *  @param gape Gap extension penalty.
+ *  @return Zero if no alignment can score minsc and one if one might.
+ */
+
+extern int seed_filter(const char *query, const int qlen, const char *target, const int tlen,
+                       const int minsc, const int sa, const int sb, const int gapo,
+                       const int gape);
 
 
 /** @fn char *revcom(const char *s, FILE *lf)
@@ -491,18 +1798,66 @@ extern ALIGN_RESULT local_align(int qlen, char *query, int tlen, char *target, c
 extern char *revcom(const char *s, FILE *lf);
 
 
+/** @fn int revcom_code(const char *s, const int len, char *code, FILE *lf)
+ *  @brief Reverse complement a DNA string and code it 0-4 for alignment in one pass.
+ *  @param s Pointer to string to be reverse-complemented (read-only).
+ *  @param len Number of bases in the string.
+ *  @param code Pointer to at least len bytes to hold the coded reverse complement.
+ *  @param lf Pointer to log file stream.
+ *  @return Zero on success and non-zero if revcom would reject the string.
+ */
+
+extern int revcom_code(const char *s, const int len, char *code, FILE *lf);
+
+
 /******************************************************
  * Edit distance functions
  ******************************************************/
 
-/** @fn int levenshtein(const char *s1, const char *s2)
- *  @brief Calculates the Levenshtein distance between two strings.
+/** @fn int levenshtein(const char *s1, const size_t len1, const char *s2, const size_t len2, const int max)
+ *  @brief Calculates the Levenshtein distance between two strings, giving up once it exceeds a bound.
  *  @param s1 Pointer to the first string (read-only).
+ *  @param len1 Length of the first string.
  *  @param s2 Pointer to the second string (read-only).
- *  @return Edit distance between the two strings.
+ *  @param len2 Length of the second string.
+ *  @param max The largest distance of interest (non-negative).
+ *  @return Edit distance between the two strings, max + 1 if it exceeds max, or negative on failure.
+ */
+
+extern int levenshtein(const char *s1, const size_t len1, const char *s2, const size_t len2, const int max);
+
+
+/** @fn int levenshtein_batch(const BARCODE_BATCH *bb, const char *s, const size_t len, const int max)
+ *  @brief Finds the single nearest barcode in a batch by bit-parallel edit distance.
+ *  @param bb Pointer to the barcode batch (read-only).
+ *  @param s Pointer to the read barcode sequence (read-only).
+ *  @param len Length of the read barcode sequence.
+ *  @param max The allowable edit distance for a barcode match.
+ *  @return Lane of the nearest barcode, or -1 if none is within max or the nearest are tied.
+ */
+
+extern int levenshtein_batch(const BARCODE_BATCH *bb, const char *s, const size_t len, const int max);
+
+
+/** @fn BARCODE_BATCH *batch_init(const POOL *pl, FILE *lf)
+ *  @brief Lays out a pool's barcodes as bit-vector match masks.
+ *  @param pl Pointer to the POOL data structure with a complete barcode hash (read-only).
+ *  @param lf Pointer to log file stream.
+ *  @return Pointer to the new barcode batch on success or NULL on failure.
+ */
+
+extern BARCODE_BATCH *batch_init(const POOL *pl, FILE *lf);
+
+
+/** @fn int build_neighbors(POOL *pl, const int dist, FILE *lf)
+ *  @brief Maps every sequence within edit distance of a pool's barcodes to its nearest sample, leaving the table NULL if it would exceed MAX_NEIGHBORS or barcodes exceed MAX_PACKED_LENGTH.
+ *  @param pl Pointer to the POOL data structure with a complete barcode hash.
+ *  @param dist The allowable edit distance for a barcode match.
+ *  @param lf Pointer to log file stream.
+ *  @return Zero on success and non-zero on failure.
  */
 
-extern int levenshtein(const char *s1, const char *s2);
+extern int build_neighbors(POOL *pl, const int dist, FILE *lf);
 
 
 /******************************************************
@@ -0,0 +1,25 @@
+/* file: fastq_key.c
+ * description: Finds the mate-pair key of a fastQ entry
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <string.h>
+#include "ddradseq.h"
+
+const char *fastq_key(const FASTQ_VIEW *v, size_t *len)
+{
+	const char *pstart = NULL;
+	const char *pend = NULL;
+
+	/* The key runs from the first colon to the first space */
+	pstart = memchr(v->id, ':', v->id_len);
+	pend = memchr(v->id, ' ', v->id_len);
+	if (!pstart || !pend || pend < pstart)
+		return NULL;
+	*len = (size_t)(pend - pstart - 1);
+
+	return pstart + 1;
+}
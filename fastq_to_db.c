@@ -9,166 +9,82 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stddef.h>
-#include <zlib.h>
 #include "ddradseq.h"
 #include "khash.h"
 
-khash_t(fastq) *fastq_to_db(const char *filename, FILE *lf)
+int fastq_to_db(const char *filename, const size_t max_mem, ARENA *ar, READ_TABLE **hp,
+                FILE *lf)
 {
-	char **buf = NULL;
-	char *idline = NULL;
-	char *mkey = NULL;
-	char *pstart = NULL;
-	char *pend = NULL;
+	const char *key = NULL;
 	int a = 0;
-	int i = 0;
-	size_t l = 0;
-	size_t lc = 0;
-	size_t pos = 0;
-	size_t strl = 0;
-	ptrdiff_t plen = 0;
-	khint_t k = 0;
-	gzFile in;
-	FASTQ *e = NULL;
-	khash_t(fastq) *h = NULL;
+	int ret = 0;
+	size_t klen = 0;
+	void **slot = NULL;
+	FASTQ_VIEW *e = NULL;
+	READ_TABLE *h = NULL;
+	FASTQ_READER *fr = NULL;
+	FASTQ_VIEW v;
 
-	/* Allocate memory for buffer from heap */
-	buf = malloc(BSIZE * sizeof(char*));
-	if (UNLIKELY(!buf))
+	/* Initialize fastQ hash */
+	h = readtab_init();
+	if (UNLIKELY(!h))
 	{
 		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-		return NULL;
-	}
-	for (i = 0; i < BSIZE; i++)
-	{
-		buf[i] = malloc(MAX_LINE_LENGTH);
-		if (UNLIKELY(!buf[i]))
-		{
-			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-			return NULL;
-		}
+		return 1;
 	}
 
-	/* Initialize fastQ hash */
-	h = kh_init(fastq);
-
 	/* Open the fastQ input stream */
-	in = gzopen(filename, "rb");
-	if (!in)
-	{
-		logerror(lf, "%s:%d Failed to open input fastQ file %s.\n", __func__,
-			     __LINE__, filename);
-		return NULL;
-	}
+	fr = fqreader_open(filename, lf);
+	if (!fr)
+		return 1;
 
 	/* Enter data from the fastQ input file into the database */
-	while (1)
+	while ((ret = fqreader_next(fr, &v)) > 0)
 	{
-		/* Fill up the buffer */
-		for (lc = 0; lc < BSIZE; lc++)
+		/* Parse Illumina identifier line */
+		key = fastq_key(&v, &klen);
+		if (!key)
 		{
-			/* Clear the buffer */
-			memset(buf[lc], 0, MAX_LINE_LENGTH);
-
-			/* Get line from the fastQ input stream */
-			if (gzgets(in, buf[lc], MAX_LINE_LENGTH) == Z_NULL)
-				break;
+			logerror(lf, "%s:%d fastQ header parsing error.\n", __func__, __LINE__);
+			return 1;
 		}
 
-		/* Iterate through lines in the buffer */
-		for (l = 0; l < lc; l++)
+		/* The entry and its lines are stored together in the arena */
+		e = arena_alloc(ar, FASTQ_SIZE(&v));
+		if (UNLIKELY(!e))
 		{
-			/* We are at the end of one fastQ entry */
-			if (l % 4 == 3)
-			{
-				/* Allocate memory for new fastQ entry */
-				e = malloc(sizeof(FASTQ));
-				if (UNLIKELY(!e))
-				{
-					logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-					return NULL;
-				}
-
-				/* Parse entry identifier */
-				pos = strcspn(buf[l-3], "\n");
-				buf[l-3][pos] = '\0';
-				strl = strlen(&buf[l-3][1]);
-				e->id = malloc(strl + 1u);
-				if (UNLIKELY(!e->id))
-				{
-					logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-					return NULL;
-				}
-				strcpy(e->id, &buf[l-3][1]);
-
-				/* Construct fastQ hash key */
-				idline = malloc(strl + 1u);
-				if (UNLIKELY(!idline))
-				{
-					logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-					return NULL;
-				}
-				strcpy(idline, &buf[l-3][1]);
-
-				/* Parse Illumina identifier line */
-				pstart = strchr(idline, ':');
-				pend = strchr(idline, ' ');
-				plen = pend - pstart;
-				mkey = strndup(pstart+1, plen - 1);
-				if (UNLIKELY(!mkey))
-				{
-					logerror(lf, "%s:%d fastQ header parsing error.\n", __func__, __LINE__);
-					return NULL;
-				}
-				k = kh_put(fastq, h, mkey, &a);
-				if (!a)
-					free(mkey);
-
-				/* Parse DNA sequence */
-				pos = strcspn(buf[l-2], "\n");
-				buf[l-2][pos] = '\0';
-				strl = strlen(&buf[l-2][0]);
-				e->seq = malloc(strl + 1u);
-				if (UNLIKELY(!e->seq))
-				{
-					logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-					return NULL;
-				}
-				strcpy(e->seq, &buf[l-2][0]);
-
-				/* Parse quality sequence */
-				pos = strcspn(buf[l], "\n");
-				buf[l][pos] = '\0';
-				strl = strlen(&buf[l][0]);
-				e->qual = malloc(strl + 1u);
-				if (UNLIKELY(!e->qual))
-				{
-					logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-					return NULL;
-				}
-				strcpy(e->qual, &buf[l][0]);
-
-				/* Add to database */
-				kh_value(h, k) = e;
+			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+			return 1;
+		}
+		copy_fastq(e, &v);
 
-				/* Free allocated memory from heap */
-				free(idline);
-			}
+		/* Add to database, a repeated key taking the later entry */
+		slot = readtab_put(h, key, klen, &a);
+		if (UNLIKELY(!slot))
+		{
+			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+			return 1;
 		}
+		*slot = e;
 
-		/* If we are at the end of the file */
-		if (lc < BSIZE)
-			break;
+		/* Give up once the table passes the memory budget, counting the */
+		/* bytes the entries take rather than the blocks holding them */
+		if (max_mem > 0 && ar->used + readtab_bytes(h) > max_mem)
+		{
+			loginfo(lf, "Forward file \'%s\' passes the %zu byte memory budget after "
+			        "%zu entries.\n", filename, max_mem, readtab_size(h));
+			fqreader_close(fr);
+			readtab_destroy(h);
+			*hp = NULL;
+			return MEM_EXCEEDED;
+		}
 	}
-
-	/* Free memory for buffer to heap */
-	for (i = 0; i < BSIZE; i++)
-		free(buf[i]);
-	free(buf);
+	if (ret < 0)
+		return 1;
 
 	/* Close input stream */
-	gzclose(in);
+	fqreader_close(fr);
 
-	return h;
+	*hp = h;
+	return 0;
 }
@@ -0,0 +1,101 @@
+/* file: find_pool.c
+ * description: Finds the sample pool a fastQ entry belongs to
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "khash.h"
+#include "ddradseq.h"
+
+/* Function prototypes */
+static POOL *memo_get(POOL_MEMO *memo, const ILLUMINA_ID *id);
+static void memo_put(POOL_MEMO *memo, const ILLUMINA_ID *id, POOL *pl);
+
+POOL *find_pool(const khash_t(pool_hash) *h, POOL_MEMO *memo, const ILLUMINA_ID *id)
+{
+	char flowcell[MAX_LINE_LENGTH];
+	uint64_t key = 0;
+	khint_t i = 0;
+	khint_t j = 0;
+	khash_t(pool) *p = NULL;
+	POOL *pl = NULL;
+
+	/* Lane files repeat a few flow cell and index pairs */
+	if (memo && (pl = memo_get(memo, id)) != NULL)
+		return pl;
+
+	if (id->flowcell_len >= MAX_LINE_LENGTH)
+		return NULL;
+	memcpy(flowcell, id->flowcell, id->flowcell_len);
+	flowcell[id->flowcell_len] = '\0';
+
+	/* Lookup flow cell identifier */
+	i = kh_get(pool_hash, h, flowcell);
+	if (i == kh_end(h))
+		return NULL;
+	p = kh_value(h, i);
+
+	/* Lookup packed pool sequence */
+	key = pack_dna(id->index, id->index_len);
+	j = kh_get(pool, p, key);
+	if (j == kh_end(p))
+		return NULL;
+	pl = kh_value(p, j);
+
+	/* Hashed keys could collide with a sequence not in the database */
+	if ((key & PACK_ESCAPE) && (strlen(pl->index) != id->index_len ||
+	    memcmp(pl->index, id->index, id->index_len) != 0))
+		return NULL;
+
+	if (memo)
+		memo_put(memo, id, pl);
+
+	return pl;
+}
+
+static POOL *memo_get(POOL_MEMO *memo, const ILLUMINA_ID *id)
+{
+	int i = 0;
+	int e = 0;
+	POOL_MEMO_ENTRY *me = NULL;
+
+	/* Start with the pair of the previous entry */
+	for (i = 0; i < memo->n; i++)
+	{
+		e = (memo->last + i) % memo->n;
+		me = &memo->entry[e];
+		if (me->index_len == id->index_len && me->flowcell_len == id->flowcell_len &&
+		    memcmp(me->index, id->index, id->index_len) == 0 &&
+		    memcmp(me->flowcell, id->flowcell, id->flowcell_len) == 0)
+		{
+			memo->last = e;
+			return me->pl;
+		}
+	}
+
+	return NULL;
+}
+
+static void memo_put(POOL_MEMO *memo, const ILLUMINA_ID *id, POOL *pl)
+{
+	POOL_MEMO_ENTRY *me = NULL;
+
+	if (id->flowcell_len > MEMO_KEY_LENGTH || id->index_len > MEMO_KEY_LENGTH)
+		return;
+
+	/* Replace entries in turn once the memo is full */
+	me = &memo->entry[memo->next];
+	memcpy(me->flowcell, id->flowcell, id->flowcell_len);
+	me->flowcell_len = id->flowcell_len;
+	memcpy(me->index, id->index, id->index_len);
+	me->index_len = id->index_len;
+	me->pl = pl;
+	memo->last = memo->next;
+	memo->next = (memo->next + 1) % POOL_MEMO_SIZE;
+	if (memo->n < POOL_MEMO_SIZE)
+		memo->n++;
+}
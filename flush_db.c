@@ -0,0 +1,65 @@
+/* file: flush_db.c
+ * description: Dumps all non-empty sample buffers in the database to file
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "khash.h"
+#include "ddradseq.h"
+
+int flush_db(const int orient, khash_t(pool_hash) *h, FILE *lf)
+{
+	int ret = 0;
+	khint_t i = 0;
+	khint_t j = 0;
+	khint_t k = 0;
+	khash_t(barcode) *b = NULL;
+	khash_t(pool) *p = NULL;
+	BARCODE *bc = NULL;
+	POOL *pl = NULL;
+
+	for (i = kh_begin(h); i != kh_end(h); i++)
+	{
+		if (kh_exist(h, i))
+		{
+			p = kh_value(h, i);
+			for (j = kh_begin(p); j != kh_end(p); j++)
+			{
+				if (kh_exist(p, j))
+				{
+					pl = kh_value(p, j);
+					b = pl->b;
+					for (k = kh_begin(b); k != kh_end(b); k++)
+					{
+						if (kh_exist(b, k))
+						{
+							bc = kh_value(b, k);
+							if (orient != REVERSE && bc->curr_bytes > 0)
+								ret = flush_buffer(FORWARD, bc, lf);
+							if (!ret && orient == REVERSE && bc->curr_bytes > 0)
+								ret = flush_buffer(REVERSE, bc, lf);
+							if (!ret && orient == PAIRED && bc->rcurr_bytes > 0)
+								ret = flush_buffer(REVERSE, bc, lf);
+							if (!ret)
+								ret = stream_close(bc->cache, &bc->fstream, lf);
+							if (!ret)
+								ret = stream_close(bc->cache, &bc->rstream, lf);
+							if (ret)
+							{
+								logerror(lf, "%s:%d Problem writing buffer to file.\n",
+								         __func__, __LINE__);
+								return 1;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return 0;
+}
@@ -7,6 +7,7 @@
  */
 
 #include <stdlib.h>
+#include <pthread.h>
 #include "khash.h"
 #include "ddradseq.h"
 
@@ -20,6 +21,7 @@ int free_db(khash_t(pool_hash) *h)
 	khash_t(barcode) *b = NULL;
 	POOL *pl = NULL;
 	BARCODE *bc = NULL;
+	STREAM_CACHE *sc = NULL;
 
 	if (h == NULL) return 1;
 
@@ -43,15 +45,27 @@ int free_db(khash_t(pool_hash) *h)
 							key = kh_key(b, k);
 							bc = kh_value(b, k);
 							free(bc->smplID);
-							free(bc->outfile);
+							free(bc->fstream.filename);
+							free(bc->rstream.filename);
+							sc = bc->cache;
 							free(bc->buffer);
+							free(bc->rbuffer);
+							pthread_mutex_destroy(&bc->lock);
 							free(bc);
 							free((void*)key);
 						}
 					}
 					kh_destroy(barcode, b);
-					key = kh_key(p, j);
-					free((void*)key);
+					if (pl->nb)
+						kh_destroy(neighbor, pl->nb);
+					if (pl->bb)
+					{
+						free(pl->bb->bc);
+						free(pl->bb->bkey);
+						free(pl->bb->mem);
+						free(pl->bb);
+					}
+					free(pl->index);
 					free(pl);
 				}
 			}
@@ -61,5 +75,6 @@ int free_db(khash_t(pool_hash) *h)
 		}
 	}
 	kh_destroy(pool_hash, h);
+	stream_cache_destroy(sc);
 	return 0;
 }
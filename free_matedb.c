@@ -10,14 +10,11 @@
 #include "khash.h"
 #include "ddradseq.h"
 
-int free_matedb(khash_t(mates) *m)
+int free_matedb(MATE_TABLE *m)
 {
-	const char *key;
-	char *v = NULL;
-
+	/* Samples are owned by the CSV database */
 	if (m == NULL)
 		return 1;
-	kh_foreach(m, key, v, free(v); free((void*)key););
-	kh_destroy(mates, m);
+	mate_table_destroy(m);
 	return 0;
 }
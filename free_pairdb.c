@@ -10,14 +10,21 @@
 #include "khash.h"
 #include "ddradseq.h"
 
-int free_pairdb(khash_t(fastq) *h)
+int free_pairdb(READ_TABLE *h, ARENA *ar)
 {
-	const char *key;
-	FASTQ *e = NULL;
+	FASTQ_VIEW *e = NULL;
 
 	if (h == NULL)
 		return 1;
-	kh_foreach(h, key, e, free(e->id); free(e->seq); free(e->qual); free(e); free((void*)key););
-	kh_destroy(fastq, h);
+
+	/* Entries held in an arena are released with it */
+	if (ar)
+		arena_destroy(ar);
+	else
+	{
+		kh_foreach_value(h->ids, e, free(e););
+		kh_foreach_value(h->names, e, free(e););
+	}
+	readtab_destroy(h);
 	return 0;
 }
@@ -21,6 +21,8 @@ const char *argp_program_bug_address = "<dgarriga@lummei.net>";
 static struct argp_option options[] =
 {
   {"across",  'a', 0,      0, "Pool sequences across flow cells [default: false]"},
+  {"lockstep",'l', 0,      0, "Parse forward and reverse files together; skips the pair stage [default: false]"},
+  {"fused",   'f', 0,      0, "Parse, pair and trim in one pass, writing only the final files; implies --lockstep [default: false]"},
   {"mode",    'm', "STR",  0, "Run mode of ddradseq program [default: all]"},
   {"out",     'o', "DIR",  0, "Parent directory to write output"},
   {"csv",     'c', "FILE", 0, "CSV file with index and barcode"},
@@ -28,8 +30,11 @@ static struct argp_option options[] =
   {"score",   's', "INT",  0, "Alignment score to consider mates properly paired [default: 100]"},
   {"gapo",    'g', "INT",  0, "Penalty for opening a gap [default: 5]"},
   {"gape",    'e', "INT",  0, "Penalty for extending open gap [default: 1]"},
+  {"insert",  'i', "MIN,MAX", 0, "Expected insert size range; trims mates by a banded overlap alignment instead of a local alignment [default: off]"},
   {"pattern", 'p', "STR",  0, "Input fastQ file glob pattern to match [default: \"*.fastq.gz\""},
-  {"threads", 't', "INT",  OPTION_HIDDEN, "Number of threads available for concurrency [default: 1]"},
+  {"threads", 't', "INT",  0, "Number of threads available for concurrency [default: 1]"},
+  {"window",  'w', "INT",  0, "Forward entries read ahead to find a mate when pairing; 0 loads the forward file into memory [default: 4096]"},
+  {"max-mem", 'M', "INT",  0, "Memory budget in megabytes for pairing, shared by the samples paired at once; larger samples are sorted on disk; 0 for no limit [default: 0]"},
   {0}
 };
 
@@ -42,6 +47,13 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 		case 'a':
 			cp->across = true;
 			break;
+		case 'l':
+			cp->lockstep = true;
+			break;
+		case 'f':
+			cp->fused = true;
+			cp->lockstep = true;
+			break;
 		case 'm':
 			cp->mode = strdup(arg);
 			break;
@@ -60,11 +72,21 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 		case 'e':
 			cp->gape = atoi(arg);
 			break;
+		case 'i':
+			if (sscanf(arg, "%d,%d", &cp->insert_min, &cp->insert_max) != 2)
+				cp->insert_max = -1;
+			break;
 		case 't':
 			cp->nthreads = atoi(arg);
 			if (cp->nthreads > 1)
 				cp->mt_mode = true;
 			break;
+		case 'w':
+			cp->window = atoi(arg);
+			break;
+		case 'M':
+			cp->max_mem = (size_t)strtoul(arg, NULL, 10) << 20;
+			break;
 		case 'p':
 			cp->glob = strdup(arg);
 			break;
@@ -113,6 +135,8 @@ CMD *get_cmdline(int argc, char *argv[])
 	/* Set argument defaults */
 	cp->across = false;
 	cp->mt_mode = false;
+	cp->lockstep = false;
+	cp->fused = false;
 	cp->parent_indir = NULL;
 	cp->parent_outdir = NULL;
 	cp->outdir = NULL;
@@ -122,8 +146,12 @@ CMD *get_cmdline(int argc, char *argv[])
 	cp->score = 100;
 	cp->gapo = 5;
 	cp->gape = 1;
+	cp->insert_min = 0;
+	cp->insert_max = 0;
 	cp->glob = NULL;
 	cp->nthreads = 1;
+	cp->window = 4096;
+	cp->max_mem = 0;
 	cp->lf = NULL;
 
 	argp_parse(&argp, argc, argv, 0, 0, cp);
@@ -148,6 +176,36 @@ CMD *get_cmdline(int argc, char *argv[])
 		return NULL;
 	}
 
+	if (cp->fused && !string_equal(cp->mode, "all"))
+	{
+		fputs("ERROR: \'--fused\' runs all stages of the pipeline and cannot be combined with \'--mode\'.\n", stderr);
+		return NULL;
+	}
+
+	if (cp->dist < 0)
+	{
+		fputs("ERROR: \'--dist\' must be a non-negative integer.\n", stderr);
+		return NULL;
+	}
+
+	if (cp->insert_max < 0 || cp->insert_min < 0 || cp->insert_min > cp->insert_max)
+	{
+		fputs("ERROR: \'--insert\' must be two non-negative integers MIN,MAX with MIN no more than MAX.\n", stderr);
+		return NULL;
+	}
+
+	if (cp->nthreads < 1)
+	{
+		fputs("ERROR: \'--threads\' must be a positive integer.\n", stderr);
+		return NULL;
+	}
+
+	if (cp->window < 0)
+	{
+		fputs("ERROR: \'--window\' must be a non-negative integer.\n", stderr);
+		return NULL;
+	}
+
 	if (!cp->glob && (string_equal(cp->mode, "parse") || string_equal(cp->mode, "all")))
 		cp->glob = strdup("*.fastq.gz");
 
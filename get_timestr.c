@@ -13,10 +13,11 @@
 int get_timestr(char *s)
 {
 	time_t rawtime;
-	struct tm *timeinfo;
+	struct tm timeinfo;
 
+	/* Parse threads log concurrently, so use the reentrant form */
 	time(&rawtime);
-	timeinfo = localtime(&rawtime);
-	strftime(s, LEN, "%c", timeinfo);
+	localtime_r(&rawtime, &timeinfo);
+	strftime(s, LEN, "%c", &timeinfo);
 	return 0;
 }
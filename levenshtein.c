@@ -1,32 +1,158 @@
 /* file: levenshtein.c
  * description: Calculates the Levenshtein distance between two strings
- * author: Daniel Garrigan
- * date: October 2016
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
  * copyright: MIT license
- * note: Code is from https://en.wikibooks.org/wiki/Algorithm_Implementation/Strings/Levenshtein_distance#C
-*/
+ * note: Bit-parallel algorithm of Myers (1999) J ACM 46:395 in the
+ *       edit distance formulation of Hyyro (2003)
+ */
 
-#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include "ddradseq.h"
 
-#define MIN3(a, b, c) ((a) < (b) ? ((a) < (c) ? (a) : (c)) : ((b) < (c) ? (b) : (c)))
+/* Function prototypes */
+static int levenshtein_dp(const char *s1, const size_t len1, const char *s2, const size_t len2,
+                          const int max);
 
-int levenshtein(const char *s1, const char *s2)
+int levenshtein(const char *s1, const size_t len1, const char *s2, const size_t len2,
+                const int max)
 {
-	unsigned int x = 0;
-	unsigned int y = 0;
-	unsigned int s1len = strlen(s1);
-	unsigned int s2len = strlen(s2);
-	unsigned int matrix[s2len+1][s1len+1];
-
-	matrix[0][0] = 0;
-	for (x = 1; x <= s2len; x++)
-		matrix[x][0] = matrix[x-1][0] + 1;
-	for (y = 1; y <= s1len; y++)
-		matrix[0][y] = matrix[0][y-1] + 1;
-	for (x = 1; x <= s2len; x++)
-		for (y = 1; y <= s1len; y++)
-			matrix[x][y] = MIN3(matrix[x-1][y] + 1, matrix[x][y-1] + 1,
-						   matrix[x-1][y-1] + (s1[y-1] == s2[x-1] ? 0 : 1));
-	return matrix[s2len][s1len];
+	unsigned char ch[64];
+	uint64_t peq[64];
+	uint64_t eq = 0;
+	uint64_t pv = 0;
+	uint64_t mv = 0;
+	uint64_t ph = 0;
+	uint64_t mh = 0;
+	uint64_t xv = 0;
+	uint64_t xh = 0;
+	uint64_t high = 0;
+	const char *pat = s1;
+	const char *txt = s2;
+	size_t m = len1;
+	size_t n = len2;
+	size_t i = 0;
+	size_t j = 0;
+	int nch = 0;
+	int c = 0;
+	long score = 0;
+
+	/* The length difference alone may exceed the bound */
+	if ((m > n ? m - n : n - m) > (size_t)max)
+		return max + 1;
+
+	/* The shorter string is the bit-vector pattern */
+	if (m > n)
+	{
+		pat = s2;
+		txt = s1;
+		m = len2;
+		n = len1;
+	}
+	if (m == 0)
+		return (int)n;
+	if (m > 64u)
+		return levenshtein_dp(s1, len1, s2, len2, max);
+
+	/* Match masks for each distinct character of the pattern */
+	for (i = 0; i < m; i++)
+	{
+		for (c = 0; c < nch; c++)
+			if (ch[c] == (unsigned char)pat[i])
+				break;
+		if (c == nch)
+		{
+			ch[nch] = (unsigned char)pat[i];
+			peq[nch++] = 0;
+		}
+		peq[c] |= (uint64_t)1 << i;
+	}
+
+	pv = m == 64u ? ~(uint64_t)0 : ((uint64_t)1 << m) - 1u;
+	high = (uint64_t)1 << (m - 1u);
+	score = (long)m;
+	for (j = 0; j < n; j++)
+	{
+		eq = 0;
+		for (c = 0; c < nch; c++)
+		{
+			if (ch[c] == (unsigned char)txt[j])
+			{
+				eq = peq[c];
+				break;
+			}
+		}
+		xv = eq | mv;
+		xh = (((eq & pv) + pv) ^ pv) | eq;
+		ph = mv | ~(xh | pv);
+		mh = pv & xh;
+		if (ph & high)
+			score++;
+		else if (mh & high)
+			score--;
+		ph = (ph << 1) | 1u;
+		mh <<= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+
+		/* Each remaining column lowers the distance by at most one */
+		if (score - (long)(n - j - 1u) > max)
+			return max + 1;
+	}
+
+	return score > max ? max + 1 : (int)score;
+}
+
+/* Dynamic programming for patterns longer than a machine word */
+static int levenshtein_dp(const char *s1, const size_t len1, const char *s2, const size_t len2,
+                          const int max)
+{
+	unsigned int *prev = NULL;
+	unsigned int *curr = NULL;
+	unsigned int *swap = NULL;
+	unsigned int rowmin = 0;
+	unsigned int d = 0;
+	size_t x = 0;
+	size_t y = 0;
+
+	prev = malloc((len1 + 1u) * sizeof(unsigned int));
+	curr = malloc((len1 + 1u) * sizeof(unsigned int));
+	if (UNLIKELY(!prev || !curr))
+	{
+		free(prev);
+		free(curr);
+		return -1;
+	}
+	for (y = 0; y <= len1; y++)
+		prev[y] = y;
+	for (x = 1; x <= len2; x++)
+	{
+		curr[0] = x;
+		rowmin = curr[0];
+		for (y = 1; y <= len1; y++)
+		{
+			d = prev[y - 1u] + (s1[y - 1u] == s2[x - 1u] ? 0 : 1);
+			if (prev[y] + 1u < d)
+				d = prev[y] + 1u;
+			if (curr[y - 1u] + 1u < d)
+				d = curr[y - 1u] + 1u;
+			curr[y] = d;
+			if (d < rowmin)
+				rowmin = d;
+		}
+		swap = prev;
+		prev = curr;
+		curr = swap;
+
+		/* Row minima never decrease */
+		if (rowmin > (unsigned int)max)
+			break;
+	}
+	d = x > len2 ? prev[len1] : (unsigned int)max + 1u;
+	free(prev);
+	free(curr);
+
+	return d > (unsigned int)max ? max + 1 : (int)d;
 }
@@ -0,0 +1,99 @@
+/* file: levenshtein_batch.c
+ * description: Finds the nearest barcode in a batch by bit-parallel edit distance
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ * note: Runs the Myers/Hyyro recurrence of levenshtein.c in each 16-bit
+ *       lane of an SSE2 vector, one sample barcode per lane
+ */
+
+#include <stdint.h>
+#include <emmintrin.h>
+#include "ddradseq.h"
+
+int levenshtein_batch(const BARCODE_BATCH *bb, const char *s, const size_t len, const int max)
+{
+	int16_t lane[BATCH_LANES];
+	int best = max + 1;
+	int nbest = 0;
+	int lbest = -1;
+	int d = 0;
+	int v = 0;
+	int l = 0;
+	int nvec = bb->nvec;
+	size_t j = 0;
+	const size_t m = bb->length;
+	__m128i eq, pv, mv, ph, mh, xv, xh, score, bound;
+	const __m128i ones = _mm_set1_epi16(-1);
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i high = _mm_set1_epi16((int16_t)(1u << (m - 1u)));
+	const __m128i shift = _mm_cvtsi32_si128((int)m - 1);
+	const __m128i *peq = NULL;
+
+	/* Barcodes too long for a lane are scored one at a time */
+	if (!bb->peq)
+	{
+		for (l = 0; l < bb->nbc; l++)
+		{
+			d = levenshtein(bb->bkey[l], m, s, len, max);
+			if (d < best)
+			{
+				best = d;
+				nbest = 1;
+				lbest = l;
+			}
+			else if (d == best && d <= max)
+				nbest++;
+		}
+		return nbest == 1 ? lbest : -1;
+	}
+
+	if ((m > len ? m - len : len - m) > (size_t)max)
+		return -1;
+
+	for (v = 0; v < nvec; v++)
+	{
+		pv = _mm_set1_epi16((int16_t)((1u << m) - 1u));
+		mv = _mm_setzero_si128();
+		score = _mm_set1_epi16((int16_t)m);
+		for (j = 0; j < len; j++)
+		{
+			peq = bb->peq + bb->code[(unsigned char)s[j]] * nvec;
+			eq = peq[v];
+			xv = _mm_or_si128(eq, mv);
+			xh = _mm_or_si128(_mm_xor_si128(_mm_add_epi16(_mm_and_si128(eq, pv), pv), pv), eq);
+			ph = _mm_or_si128(mv, _mm_andnot_si128(_mm_or_si128(xh, pv), ones));
+			mh = _mm_and_si128(pv, xh);
+			score = _mm_add_epi16(score, _mm_srl_epi16(_mm_and_si128(ph, high), shift));
+			score = _mm_sub_epi16(score, _mm_srl_epi16(_mm_and_si128(mh, high), shift));
+			ph = _mm_or_si128(_mm_slli_epi16(ph, 1), one);
+			mh = _mm_slli_epi16(mh, 1);
+			pv = _mm_or_si128(mh, _mm_andnot_si128(_mm_or_si128(xv, ph), ones));
+			mv = _mm_and_si128(ph, xv);
+
+			/* Stop once no lane can come back within the best distance so far */
+			bound = _mm_set1_epi16((int16_t)(best + (int)(len - j - 1u)));
+			if (_mm_movemask_epi8(_mm_cmpgt_epi16(score, bound)) == 0xffff)
+				break;
+		}
+		if (j < len)
+			continue;
+
+		_mm_storeu_si128((__m128i*)lane, score);
+		for (l = 0; l < BATCH_LANES && v * BATCH_LANES + l < bb->nbc; l++)
+		{
+			d = lane[l];
+			if (d < best)
+			{
+				best = d;
+				nbest = 1;
+				lbest = v * BATCH_LANES + l;
+			}
+			else if (d == best && d <= max)
+				nbest++;
+		}
+	}
+
+	return nbest == 1 ? lbest : -1;
+}
@@ -20,24 +20,36 @@
 const ALIGN_RESULT g_defr = { 0, -1, -1, -1, -1, -1, -1 };
 
 /* Function prototypes */
-static ALIGN_QUERY* align_init(int qlen, const char *query, const char *mat, FILE *lf);
+static ALIGN_QUERY* align_init(int size, int qlen, const char *query, const char *mat,
+                               ALIGN_WORK *w, FILE *lf);
 
 ALIGN_RESULT smith_waterman(ALIGN_QUERY *q, int tlen, const char *target, int _gapo,
-                            int _gape, int xtra, FILE *lf);
+                            int _gape, int xtra, ALIGN_WORK *w, FILE *lf);
+
+static ALIGN_RESULT smith_waterman16(ALIGN_QUERY *q, int tlen, const char *target, int _gapo,
+                                     int _gape, int xtra);
 
 static void revseq(int l, char *s);
 
 
 ALIGN_RESULT local_align(int qlen, char *query, int tlen, char *target,
-                         const char *mat, int gapo, int gape, int xtra, FILE *lf)
+                         const char *mat, int gapo, int gape, int xtra, ALIGN_WORK *w, FILE *lf)
 {
+	int size = 1;
 	ALIGN_QUERY *q;
 	ALIGN_RESULT r;
 	ALIGN_RESULT rr;
 
-	q = align_init(qlen, query, mat, lf);
-	r = smith_waterman(q, tlen, target, gapo, gape, xtra, lf);
-	free(q);
+	q = align_init(size, qlen, query, mat, w, lf);
+	r = smith_waterman(q, tlen, target, gapo, gape, xtra, w, lf);
+
+	/* Only alignments that saturate a byte are run again with 16-bit scores */
+	if (r.score == 255)
+	{
+		size = 2;
+		q = align_init(size, qlen, query, mat, w, lf);
+		r = smith_waterman16(q, tlen, target, gapo, gape, xtra);
+	}
 	if (((xtra & KSW_XSTART) == 0 || (xtra & KSW_XSUBO)) && r.score < (xtra & 0xffff))
 		return r;
 	revseq(r.query_end + 1, query);
@@ -45,11 +57,13 @@ ALIGN_RESULT local_align(int qlen, char *query, int tlen, char *target,
 	/* +1 because qe/te points to the exact end */
 	/* not the position after the end */
 	revseq(r.target_end + 1, target);
-	q = align_init(r.query_end + 1, query, mat, lf);
-	rr = smith_waterman(q, tlen, target, gapo, gape, KSW_XSTOP | r.score, lf);
+	q = align_init(size, r.query_end + 1, query, mat, w, lf);
+	if (size == 1)
+		rr = smith_waterman(q, tlen, target, gapo, gape, KSW_XSTOP | r.score, w, lf);
+	else
+		rr = smith_waterman16(q, tlen, target, gapo, gape, KSW_XSTOP | r.score);
 	revseq(r.query_end + 1, query);
 	revseq(r.target_end + 1, target);
-	free(q);
 	if (r.score == rr.score)
 	{
 		r.target_begin = r.target_end - rr.target_end;
@@ -58,7 +72,8 @@ ALIGN_RESULT local_align(int qlen, char *query, int tlen, char *target,
 	return r;
 }
 
-static ALIGN_QUERY *align_init(int qlen, const char *query, const char *mat, FILE *lf)
+static ALIGN_QUERY *align_init(int size, int qlen, const char *query, const char *mat,
+                               ALIGN_WORK *w, FILE *lf)
 {
 	int slen = 0;
 	int a = 0;
@@ -67,13 +82,15 @@ static ALIGN_QUERY *align_init(int qlen, const char *query, const char *mat, FIL
 	ALIGN_QUERY *q = NULL;
 
 	/* Number of values per __m128i */
-	p = 16;
+	p = 8 * (3 - size);
 
 	/* Segmented length */
 	slen = (qlen + p - 1) / p;
 
-	/* Allocate memory for query profile */
-	if ((q = malloc(sizeof(ALIGN_QUERY) + 256 + 16 * slen * (ALPHA_SIZE + 4))) == NULL)
+	/* The query profile reuses the buffer of the last pair when it is long enough */
+	q = grow_buffer(&w->prof, &w->prof_size,
+	                sizeof(ALIGN_QUERY) + 256 + 16 * slen * (ALPHA_SIZE + 4));
+	if (!q)
 	{
 		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
 		return NULL;
@@ -107,23 +124,42 @@ static ALIGN_QUERY *align_init(int qlen, const char *query, const char *mat, FIL
 	/* Difference between the min and max scores */
 	q->mdiff += q->shift;
 
-	char *t = (char*)q->qp;
-	for (a = 0; a < ALPHA_SIZE; a++)
+	if (size == 1)
 	{
-		int i = 0;
-		int k = 0;
-		int nlen = slen * p;
-		const char *ma = mat + a * ALPHA_SIZE;
-
-		for (i = 0; i < slen; i++)
-			for (k = i; k < nlen; k += slen)
-				*t++ = (k >= qlen ? 0 : ma[(unsigned char)query[k]]) + q->shift;
+		char *t = (char*)q->qp;
+		for (a = 0; a < ALPHA_SIZE; a++)
+		{
+			int i = 0;
+			int k = 0;
+			int nlen = slen * p;
+			const char *ma = mat + a * ALPHA_SIZE;
+
+			for (i = 0; i < slen; i++)
+				for (k = i; k < nlen; k += slen)
+					*t++ = (k >= qlen ? 0 : ma[(unsigned char)query[k]]) + q->shift;
+		}
+	}
+	else
+	{
+		/* 16-bit scores are signed and need no shift */
+		short *t = (short*)q->qp;
+		for (a = 0; a < ALPHA_SIZE; a++)
+		{
+			int i = 0;
+			int k = 0;
+			int nlen = slen * p;
+			const char *ma = mat + a * ALPHA_SIZE;
+
+			for (i = 0; i < slen; i++)
+				for (k = i; k < nlen; k += slen)
+					*t++ = k >= qlen ? 0 : ma[(unsigned char)query[k]];
+		}
 	}
 	return q;
 }
 
 ALIGN_RESULT smith_waterman(ALIGN_QUERY *q, int tlen, const char *target,
-                            int _gapo, int _gape, int xtra, FILE *lf)
+                            int _gapo, int _gape, int xtra, ALIGN_WORK *w, FILE *lf)
 {
 	int slen = 0;
 	int i = 0;
@@ -156,8 +192,9 @@ ALIGN_RESULT smith_waterman(ALIGN_QUERY *q, int tlen, const char *target,
 	r = g_defr;
 	minsc = xtra & KSW_XSUBO ? xtra & 0xffff : 0x10000;
 	endsc = xtra & KSW_XSTOP ? xtra & 0xffff : 0x10000;
-	m_b = n_b = 0;
-	b = 0;
+	n_b = 0;
+	m_b = (int)(w->b_size / 8u);
+	b = w->b;
 	zero = _mm_set1_epi32(0);
 	gapoe = _mm_set1_epi8(_gapo + _gape);
 	gape = _mm_set1_epi8(_gape);
@@ -276,7 +313,7 @@ end_loop16:
 				if (n_b == m_b)
 				{
 					m_b = m_b ? m_b << 1 : 8;
-					if ((b = realloc(b, 8 * m_b)) == NULL)
+					if ((b = grow_buffer((void**)&w->b, &w->b_size, 8 * m_b)) == NULL)
 					{
 						logerror(lf, "%s:%d Memory reallocation failure.\n", __func__, __LINE__);
 						return r;
@@ -332,7 +369,7 @@ end_loop16:
 				r.query_end = i / 16 + i % 16 * slen;
 			}
 		}
-		if (b)
+		if (n_b > 0)
 		{
 			i = (r.score + q->max - 1) / q->max;
 			low = te - i;
@@ -348,7 +385,138 @@ end_loop16:
 			}
 		}
 	}
-	free (b);
+
+	return r;
+}
+
+static ALIGN_RESULT smith_waterman16(ALIGN_QUERY *q, int tlen, const char *target,
+                                     int _gapo, int _gape, int xtra)
+{
+	int slen = 0;
+	int i = 0;
+	int te = -1;
+	int gmax = 0;
+	int endsc = 0;
+	__m128i zero;
+	__m128i gapoe;
+	__m128i gape;
+	__m128i *H0;
+	__m128i *H1;
+	__m128i *E;
+	__m128i *Hmax;
+	ALIGN_RESULT r;
+
+#define __max_8(ret, xx) do { \
+		(xx) = _mm_max_epi16((xx), _mm_srli_si128((xx), 8)); \
+		(xx) = _mm_max_epi16((xx), _mm_srli_si128((xx), 4)); \
+		(xx) = _mm_max_epi16((xx), _mm_srli_si128((xx), 2)); \
+		(ret) = _mm_extract_epi16((xx), 0); \
+	} while (0)
+
+	/* Initialization; the second best alignment is not looked for */
+	r = g_defr;
+	endsc = xtra & KSW_XSTOP ? xtra & 0xffff : 0x10000;
+	zero = _mm_set1_epi32(0);
+	gapoe = _mm_set1_epi16(_gapo + _gape);
+	gape = _mm_set1_epi16(_gape);
+	H0 = q->H0;
+	H1 = q->H1;
+	E = q->E;
+	Hmax = q->Hmax;
+	slen = q->slen;
+	for (i = 0; i < slen; i++)
+	{
+		_mm_store_si128(E + i, zero);
+		_mm_store_si128(H0 + i, zero);
+		_mm_store_si128(Hmax + i, zero);
+	}
+
+	/* Core loop, as in smith_waterman with eight lanes of 16 bits */
+	for (i = 0; i < tlen; i++)
+	{
+		int j = 0;
+		int k = 0;
+		int imax = 0;
+		__m128i e;
+		__m128i h;
+		__m128i f = zero;
+		__m128i max = zero;
+		__m128i *S = q->qp + target[i] * slen;
+
+		/* h=H(i-1,-1) */
+		h = _mm_load_si128(H0 + slen - 1);
+		h = _mm_slli_si128(h, 2);
+
+		for (j = 0; LIKELY(j < slen); j++)
+		{
+			/* h=H'(i-1,j-1)+S(i,j), which cannot fall below E or F */
+			h = _mm_adds_epi16(h, _mm_load_si128(S + j));
+			e = _mm_load_si128(E + j);
+			h = _mm_max_epi16(h, e);
+			h = _mm_max_epi16(h, f);
+			max = _mm_max_epi16(max, h);
+			_mm_store_si128(H1 + j, h);
+
+			/* E'(i+1,j) and F'(i,j+1) */
+			h = _mm_subs_epu16(h, gapoe);
+			e = _mm_subs_epu16(e, gape);
+			e = _mm_max_epi16(e, h);
+			_mm_store_si128(E + j, e);
+			f = _mm_subs_epu16(f, gape);
+			f = _mm_max_epi16(f, h);
+			h = _mm_load_si128(H0 + j);
+		}
+
+		/* Lazy-F loop */
+		for (k = 0; LIKELY(k < 8); k++)
+		{
+			f = _mm_slli_si128(f, 2);
+			for (j = 0; LIKELY(j < slen); j++)
+			{
+				h = _mm_load_si128(H1 + j);
+				h = _mm_max_epi16(h, f);
+				_mm_store_si128(H1 + j, h);
+				h = _mm_subs_epu16(h, gapoe);
+				f = _mm_subs_epu16(f, gape);
+				if (UNLIKELY(!_mm_movemask_epi8(_mm_cmpgt_epi16(f, h))))
+					goto end_loop8;
+			}
+		}
+end_loop8:
+		__max_8(imax, max);
+		if (imax > gmax)
+		{
+			gmax = imax;
+			te = i;
+			for (j = 0; LIKELY(j < slen); j++)
+				_mm_store_si128(Hmax + j, _mm_load_si128(H1 + j));
+			if (gmax >= endsc)
+				break;
+		}
+		S = H1;
+		H1 = H0;
+		H0 = S;
+	}
+
+	r.score = gmax;
+	r.target_end = te;
+
+	/* The query end is the first maximum in striped order, padding left out */
+	{
+		int max = -1;
+		int pos = 0;
+		short *t = (short*)Hmax;
+
+		for (i = 0; i < slen * 8; i++, t++)
+		{
+			pos = i / 8 + i % 8 * slen;
+			if (pos < q->qlen && (int)*t > max)
+			{
+				max = *t;
+				r.query_end = pos;
+			}
+		}
+	}
 
 	return r;
 }
@@ -67,6 +67,10 @@ int log_init(CMD *cp)
 	loginfo(cp->lf, "user specified \'%s\' as output directory.\n", cp->parent_outdir);
 	loginfo(cp->lf, "output will be written to \'%s\'.\n", cp->outdir);
 	loginfo(cp->lf, "program will use edit distance of %d base difference.\n", cp->dist);
+	if (cp->fused)
+		loginfo(cp->lf, "mates will be paired and trimmed as they are parsed.\n");
+	else if (cp->lockstep)
+		loginfo(cp->lf, "forward and reverse fastQ files will be parsed in lockstep.\n");
 	if (cp->mt_mode)
 		loginfo(cp->lf, "program is running in multi-threaded mode using %d threads.\n", cp->nthreads);
 	loginfo(cp->lf, "program has started in \'%s\' mode ", cp->mode);
@@ -0,0 +1,59 @@
+/* file: lookup_barcode.c
+ * description: Finds the sample a forward fastQ entry belongs to
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "khash.h"
+#include "ddradseq.h"
+
+int lookup_barcode(const CMD *cp, const khash_t(pool_hash) *h, POOL_MEMO *memo, const FASTQ_VIEW *v,
+                   const ILLUMINA_ID *id, size_t *trim, BARCODE **bc)
+{
+	int lane = 0;
+	size_t bl = 0;
+	khint_t k = 0;
+	khash_t(neighbor) *nb = NULL;
+	POOL *pl = NULL;
+	FILE *lf = cp->lf;
+
+	*bc = NULL;
+
+	/* Lookup flow cell identifier and pool sequence */
+	pl = find_pool(h, memo, id);
+	if (!pl)
+	{
+		logerror(lf, "%s:%d Pool sequence %.*s not found in association with flow cell %.*s. Possible incomplete CSV database file.\n",
+		         __func__, __LINE__, (int)id->index_len, id->index, (int)id->flowcell_len,
+		         id->flowcell);
+		return 1;
+	}
+	nb = pl->nb;
+	bl = pl->barcode_length;
+	*trim = bl;
+
+	/* Skip entries too short to hold the barcode */
+	if (v->seq_len < bl || v->qual_len < bl)
+		return 0;
+
+	/* One probe finds exact and erroneous barcodes alike; */
+	/* ambiguous sequences have no sample */
+	if (nb)
+	{
+		k = kh_get(neighbor, nb, pack_dna(v->seq, bl));
+		if (k != kh_end(nb))
+			*bc = kh_value(nb, k).bc;
+		return 0;
+	}
+
+	/* Pools without a neighborhood table score every barcode at once */
+	lane = levenshtein_batch(pl->bb, v->seq, bl, cp->dist);
+	if (lane >= 0)
+		*bc = pl->bb->bc[lane];
+
+	return 0;
+}
@@ -0,0 +1,268 @@
+/* file: mate_table.c
+ * description: Open-addressing table from forward read keys to sample indices
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "khash.h"
+#include "ddradseq.h"
+
+/* Marks a slot holding no key; packed keys never set the top bit */
+#define EMPTY_KEY UINT64_MAX
+
+/* Function prototypes */
+static int alloc_slots(MATE_TABLE *mt, const size_t cap);
+static int grow_slots(MATE_TABLE *mt);
+static size_t home_slot(const uint64_t key, const size_t mask);
+static size_t find_slot(const MATE_TABLE *mt, const uint64_t key);
+
+MATE_TABLE *mate_table_init(const khash_t(pool_hash) *h)
+{
+	uint32_t n = 0;
+	khint_t i = 0;
+	khint_t j = 0;
+	khint_t k = 0;
+	khash_t(pool) *p = NULL;
+	khash_t(barcode) *b = NULL;
+	MATE_TABLE *mt = NULL;
+
+	mt = calloc(1, sizeof(MATE_TABLE));
+	if (UNLIKELY(!mt))
+		return NULL;
+	mt->names = kh_init(mate_name);
+	if (UNLIKELY(!mt->names || alloc_slots(mt, MATE_TABLE_INIT_SIZE)))
+	{
+		mate_table_destroy(mt);
+		return NULL;
+	}
+
+	/* Number the samples so a mate is recorded by index rather than by barcode */
+	for (i = kh_begin(h); i != kh_end(h); i++)
+		if (kh_exist(h, i))
+			for (p = kh_value(h, i), j = kh_begin(p); j != kh_end(p); j++)
+				if (kh_exist(p, j))
+					mt->nsamples += kh_size(kh_value(p, j)->b);
+	mt->sample = malloc((mt->nsamples + 1u) * sizeof(BARCODE*));
+	if (UNLIKELY(!mt->sample))
+	{
+		mate_table_destroy(mt);
+		return NULL;
+	}
+	for (i = kh_begin(h); i != kh_end(h); i++)
+	{
+		if (!kh_exist(h, i))
+			continue;
+		p = kh_value(h, i);
+		for (j = kh_begin(p); j != kh_end(p); j++)
+		{
+			if (!kh_exist(p, j))
+				continue;
+			b = kh_value(p, j)->b;
+			for (k = kh_begin(b); k != kh_end(b); k++)
+			{
+				if (kh_exist(b, k))
+				{
+					kh_value(b, k)->index = n;
+					mt->sample[n++] = kh_value(b, k);
+				}
+			}
+		}
+	}
+
+	return mt;
+}
+
+int mate_table_put(MATE_TABLE *mt, const char *key, const size_t len, const uint32_t idx)
+{
+	char name[MAX_LINE_LENGTH];
+	char *s = NULL;
+	int a = 0;
+	int ret = 0;
+	size_t x = 0;
+	uint64_t packed = 0;
+	khint_t k = 0;
+
+	/* Number each new run and flow cell while there is room */
+	ret = pack_readkey(&mt->rp, key, len, &packed);
+	if (ret == PREFIX_UNKNOWN && add_readprefix(&mt->rp, key, len) == 0)
+		ret = pack_readkey(&mt->rp, key, len, &packed);
+	if (ret == 0)
+	{
+		/* Keep the load below three quarters so probe runs stay short */
+		if ((mt->n + 1u) * 4u > mt->cap * 3u && grow_slots(mt))
+			return 1;
+		x = find_slot(mt, packed);
+		if (mt->keys[x] == EMPTY_KEY)
+		{
+			mt->keys[x] = packed;
+			mt->vals[x] = idx;
+			mt->n++;
+		}
+		return 0;
+	}
+
+	/* Other identifiers are keyed by the name itself */
+	if (len >= MAX_LINE_LENGTH)
+		return 1;
+	memcpy(name, key, len);
+	name[len] = '\0';
+	k = kh_get(mate_name, mt->names, name);
+	if (k != kh_end(mt->names))
+		return 0;
+	s = strdup(name);
+	if (UNLIKELY(!s))
+		return 1;
+	k = kh_put(mate_name, mt->names, s, &a);
+	if (UNLIKELY(a < 0))
+	{
+		free(s);
+		return 1;
+	}
+	kh_value(mt->names, k) = idx;
+
+	return 0;
+}
+
+int mate_table_get(const MATE_TABLE *mt, const char *key, const size_t len, uint32_t *idx)
+{
+	char name[MAX_LINE_LENGTH];
+	size_t x = 0;
+	uint64_t packed = 0;
+	khint_t k = 0;
+
+	if (pack_readkey(&mt->rp, key, len, &packed) == 0)
+	{
+		x = find_slot(mt, packed);
+		if (mt->keys[x] == EMPTY_KEY)
+			return 1;
+		*idx = mt->vals[x];
+		return 0;
+	}
+
+	if (kh_size(mt->names) == 0 || len >= MAX_LINE_LENGTH)
+		return 1;
+	memcpy(name, key, len);
+	name[len] = '\0';
+	k = kh_get(mate_name, mt->names, name);
+	if (k == kh_end(mt->names))
+		return 1;
+	*idx = kh_value(mt->names, k);
+
+	return 0;
+}
+
+void mate_table_destroy(MATE_TABLE *mt)
+{
+	int i = 0;
+	khint_t k = 0;
+
+	if (!mt)
+		return;
+	if (mt->names)
+	{
+		for (k = kh_begin(mt->names); k != kh_end(mt->names); k++)
+			if (kh_exist(mt->names, k))
+				free((char*)kh_key(mt->names, k));
+		kh_destroy(mate_name, mt->names);
+	}
+	for (i = 0; i < mt->rp.n; i++)
+		free(mt->rp.prefix[i]);
+	free(mt->keys);
+	free(mt->sample);
+	free(mt);
+}
+
+static int alloc_slots(MATE_TABLE *mt, const size_t cap)
+{
+	/* Keys and sample indices share one allocation */
+	mt->keys = malloc(cap * (sizeof(uint64_t) + sizeof(uint32_t)));
+	if (UNLIKELY(!mt->keys))
+		return 1;
+	mt->vals = (uint32_t*)(mt->keys + cap);
+	memset(mt->keys, 0xff, cap * sizeof(uint64_t));
+	mt->cap = cap;
+	mt->n = 0;
+
+	return 0;
+}
+
+static int grow_slots(MATE_TABLE *mt)
+{
+	size_t cap = mt->cap;
+	size_t mask = cap * 2u - 1u;
+	size_t i = 0;
+	size_t x = 0;
+	uint64_t key = 0;
+	uint64_t tkey = 0;
+	uint32_t val = 0;
+	uint32_t tval = 0;
+	uint64_t *keys = NULL;
+	unsigned char *filled = NULL;
+
+	/* Grow in place so the old and new slots are never both held */
+	filled = calloc(cap / 4u, 1);
+	if (UNLIKELY(!filled))
+		return 1;
+	keys = realloc(mt->keys, cap * 2u * (sizeof(uint64_t) + sizeof(uint32_t)));
+	if (UNLIKELY(!keys))
+	{
+		free(filled);
+		return 1;
+	}
+	mt->keys = keys;
+	mt->vals = (uint32_t*)(keys + cap * 2u);
+	memcpy(mt->vals, keys + cap, cap * sizeof(uint32_t));
+	memset(keys + cap, 0xff, cap * sizeof(uint64_t));
+	mt->cap = cap * 2u;
+
+	/* Move each old key to its new slot, carrying along any old key it displaces */
+	for (i = 0; i < cap; i++)
+	{
+		if (keys[i] == EMPTY_KEY || filled[i >> 3] >> (i & 7u) & 1u)
+			continue;
+		key = keys[i];
+		val = mt->vals[i];
+		keys[i] = EMPTY_KEY;
+		while (1)
+		{
+			x = home_slot(key, mask);
+			while (filled[x >> 3] >> (x & 7u) & 1u)
+				x = (x + 1u) & mask;
+			filled[x >> 3] |= (unsigned char)(1u << (x & 7u));
+			tkey = keys[x];
+			tval = mt->vals[x];
+			keys[x] = key;
+			mt->vals[x] = val;
+			if (tkey == EMPTY_KEY)
+				break;
+			key = tkey;
+			val = tval;
+		}
+	}
+	free(filled);
+
+	return 0;
+}
+
+static size_t home_slot(const uint64_t key, const size_t mask)
+{
+	/* Fibonacci hashing spreads the clustered tile and coordinate bits */
+	return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+static size_t find_slot(const MATE_TABLE *mt, const uint64_t key)
+{
+	size_t mask = mt->cap - 1u;
+	size_t x = 0;
+
+	x = home_slot(key, mask);
+	while (mt->keys[x] != EMPTY_KEY && mt->keys[x] != key)
+		x = (x + 1u) & mask;
+
+	return x;
+}
@@ -0,0 +1,236 @@
+/* file: merge_mates.c
+ * description: Pairs mates in two co-sorted fastQ files with a streaming merge-join
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include "khash.h"
+#include "ddradseq.h"
+
+/* Function prototypes */
+static int stash_entry(READ_TABLE *h, const char *key, const size_t len, const FASTQ_VIEW *v,
+                       size_t *held);
+static void drop_entry(READ_TABLE *h, const char *key, const size_t len, void **slot,
+                       size_t *held);
+
+int merge_mates(const char *fin, const char *rin, const char *ffor, const char *frev,
+                const int window, const size_t max_mem, BGZF_POOL *bp, FILE *lf)
+{
+	const char *fkey = NULL;
+	const char *rkey = NULL;
+	bool found = false;
+	bool fdone = false;
+	int n = 0;
+	int ret = 0;
+	size_t fkl = 0;
+	size_t rkl = 0;
+	size_t npairs = 0;
+	size_t held = 0;
+	size_t peak = 0;
+	void **slot = NULL;
+	READ_TABLE *fh = NULL;
+	READ_TABLE *rh = NULL;
+	FASTQ_READER *fp = NULL;
+	FASTQ_READER *rp = NULL;
+	BGZF *fout = NULL;
+	BGZF *rout = NULL;
+	FASTQ_VIEW *e = NULL;
+	FASTQ_VIEW fv;
+	FASTQ_VIEW rv;
+
+	/* Entries passed over in either file wait here for their mates */
+	fh = readtab_init();
+	rh = readtab_init();
+	if (UNLIKELY(!fh || !rh))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return 1;
+	}
+
+	/* Open the fastQ input streams */
+	fp = fqreader_open(fin, lf);
+	if (!fp)
+		return 1;
+	rp = fqreader_open(rin, lf);
+	if (!rp)
+		return 1;
+
+	/* Open the output fastQ file streams */
+	fout = bgzf_open(ffor, bp, lf);
+	if (!fout)
+	{
+		logerror(lf, "%s:%d Unable to forward output file \'%s\': %s.\n", __func__,
+		         __LINE__, ffor, strerror(errno));
+		return 1;
+	}
+	rout = bgzf_open(frev, bp, lf);
+	if (!rout)
+	{
+		logerror(lf, "%s:%d Unable to reverse output file \'%s\': %s.\n", __func__,
+		         __LINE__, frev, strerror(errno));
+		return 1;
+	}
+
+	/* Reverse entries are written in file order as their mates are found */
+	while ((ret = fqreader_next(rp, &rv)) > 0)
+	{
+		rkey = fastq_key(&rv, &rkl);
+		if (!rkey)
+			goto badentry;
+
+		/* The mate may already have been passed over */
+		found = false;
+		slot = readtab_size(fh) > 0 ? readtab_get(fh, rkey, rkl) : NULL;
+		if (slot)
+		{
+			e = *slot;
+			bgzf_write_fastq(fout, e);
+			bgzf_write_fastq(rout, &rv);
+			drop_entry(fh, rkey, rkl, slot, &held);
+			npairs++;
+			found = true;
+		}
+
+		/* Otherwise it is usually the next forward entry */
+		for (n = 0; !found && !fdone && n < window; n++)
+		{
+			ret = fqreader_next(fp, &fv);
+			if (ret < 0)
+				goto cleanup;
+			if (ret == 0)
+			{
+				fdone = true;
+				break;
+			}
+			fkey = fastq_key(&fv, &fkl);
+			if (!fkey)
+				goto badentry;
+			if (fkl == rkl && memcmp(fkey, rkey, rkl) == 0)
+			{
+				bgzf_write_fastq(fout, &fv);
+				bgzf_write_fastq(rout, &rv);
+				npairs++;
+				found = true;
+				break;
+			}
+
+			/* Check for a reverse entry that ran ahead of its mate */
+			slot = readtab_size(rh) > 0 ? readtab_get(rh, fkey, fkl) : NULL;
+			if (slot)
+			{
+				e = *slot;
+				bgzf_write_fastq(fout, &fv);
+				bgzf_write_fastq(rout, e);
+				drop_entry(rh, fkey, fkl, slot, &held);
+				npairs++;
+			}
+			else if (stash_entry(fh, fkey, fkl, &fv, &held))
+				goto nomem;
+		}
+
+		/* A mate beyond the window may still turn up later */
+		if (!found && !fdone && stash_entry(rh, rkey, rkl, &rv, &held))
+			goto nomem;
+		if (readtab_size(fh) + readtab_size(rh) > peak)
+			peak = readtab_size(fh) + readtab_size(rh);
+
+		/* Files too far out of order are left to the sorted-run merge */
+		if (max_mem > 0 && held > max_mem)
+		{
+			loginfo(lf, "Mates held out of order pass the %zu byte memory budget.\n", max_mem);
+			ret = MEM_EXCEEDED;
+			goto cleanup;
+		}
+	}
+	if (ret < 0)
+		goto cleanup;
+
+	/* Forward entries left in the file can only pair with held reverse entries */
+	while (!fdone && readtab_size(rh) > 0 && (ret = fqreader_next(fp, &fv)) > 0)
+	{
+		fkey = fastq_key(&fv, &fkl);
+		if (!fkey)
+			goto badentry;
+		slot = readtab_get(rh, fkey, fkl);
+		if (slot)
+		{
+			e = *slot;
+			bgzf_write_fastq(fout, &fv);
+			bgzf_write_fastq(rout, e);
+			drop_entry(rh, fkey, fkl, slot, &held);
+			npairs++;
+		}
+	}
+	if (ret < 0)
+		goto cleanup;
+
+	loginfo(lf, "Paired %zu mates with at most %zu entries held out of order.\n", npairs, peak);
+	ret = 0;
+
+cleanup:
+	/* Free memory from the heap */
+	free_pairdb(fh, NULL);
+	free_pairdb(rh, NULL);
+
+	/* Close the file streams */
+	fqreader_close(fp);
+	fqreader_close(rp);
+	if (ret < 0)
+		ret = 1;
+	if (bgzf_close(fout) | bgzf_close(rout))
+		ret = 1;
+
+	return ret;
+
+badentry:
+	logerror(lf, "%s:%d fastQ header parsing error.\n", __func__, __LINE__);
+	return 1;
+
+nomem:
+	logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+	return 1;
+}
+
+static int stash_entry(READ_TABLE *h, const char *key, const size_t len, const FASTQ_VIEW *v,
+                       size_t *held)
+{
+	int a = 0;
+	void **slot = NULL;
+	FASTQ_VIEW *e = NULL;
+
+	e = malloc(FASTQ_SIZE(v));
+	if (UNLIKELY(!e))
+		return 1;
+	copy_fastq(e, v);
+
+	/* A repeated key replaces the earlier entry */
+	slot = readtab_put(h, key, len, &a);
+	if (UNLIKELY(!slot))
+		return 1;
+	if (!a)
+		drop_entry(NULL, key, len, slot, held);
+	*slot = e;
+	*held += FASTQ_SIZE(e) + len + 1u;
+
+	return 0;
+}
+
+static void drop_entry(READ_TABLE *h, const char *key, const size_t len, void **slot,
+                       size_t *held)
+{
+	FASTQ_VIEW *e = *slot;
+
+	*held -= FASTQ_SIZE(e) + len + 1u;
+	free(e);
+
+	/* Without a table the slot is about to be reused */
+	if (h)
+		readtab_del(h, key, len);
+}
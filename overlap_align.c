@@ -0,0 +1,169 @@
+/* file: overlap_align.c
+ * description: Banded alignment of the start of a target to the end of a query
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ * note: The alignment starts at the first base of the target, anywhere in
+ *       the query, and runs to the end of either sequence, so its score and
+ *       the query base facing the start of the target come out of one pass.
+ *       Each cell carries the query position its alignment started from in
+ *       place of a traceback. Only starts in [dlo, dhi] are allowed, and
+ *       cells stray from their diagonals by no more bases than the gaps an
+ *       alignment scoring minsc can pay for
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "ddradseq.h"
+
+/* Score of a cell no alignment reaches, low enough never to overflow */
+#define NEG_INF (INT_MIN / 4)
+
+int overlap_align(const char *query, const int qlen, const char *target, const int tlen,
+                  int dlo, int dhi, const int minsc, const int sa, const int sb, const int gapo,
+                  const int gape, ALIGN_RESULT *r, ALIGN_WORK *w, FILE *lf)
+{
+	int *H = NULL;
+	int *E = NULL;
+	int *HO = NULL;
+	int *EO = NULL;
+	int i = 0;
+	int j = 0;
+	int jlo = 0;
+	int jhi = 0;
+	int h = 0;
+	int e = 0;
+	int f = 0;
+	int o = 0;
+	int eo = 0;
+	int fo = 0;
+	int hd = 0;
+	int od = 0;
+	int t = 0;
+	int len = qlen < tlen ? qlen : tlen;
+	int drift = 0;
+
+	r->score = -1;
+	r->target_begin = -1;
+	r->target_end = -1;
+	r->query_begin = -1;
+	r->query_end = -1;
+	r->score2 = -1;
+	r->target_end2 = -1;
+
+	/* The query must hold a match for every point of the score past its start */
+	if (dlo < 0)
+		dlo = 0;
+	if (dhi > qlen - 1)
+		dhi = qlen - 1;
+	if (sa > 0 && minsc > 0 && dhi > qlen - (minsc + sa - 1) / sa)
+		dhi = qlen - (minsc + sa - 1) / sa;
+	if (dlo > dhi || tlen < 1)
+		return 0;
+
+	/* Bases of gap an alignment can afford once its matches pay for minsc */
+	drift = len;
+	if (gape > 0)
+		drift = (len * sa - minsc - gapo) / gape;
+	if (drift < 0)
+		drift = 0;
+	if (drift > len)
+		drift = len;
+
+	H = grow_buffer(&w->dp, &w->dp_size, 4u * qlen * sizeof(int));
+	if (UNLIKELY(!H))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return 1;
+	}
+	E = H + qlen;
+	HO = E + qlen;
+	EO = HO + qlen;
+	for (j = 0; j < qlen; j++)
+	{
+		H[j] = NEG_INF;
+		E[j] = NEG_INF;
+		HO[j] = 0;
+		EO[j] = 0;
+	}
+
+	/* Each row is one target base against the band of the query */
+	for (i = 0; i < tlen; i++)
+	{
+		jlo = i + dlo - drift > 0 ? i + dlo - drift : 0;
+		jhi = i + dhi + drift < qlen - 1 ? i + dhi + drift : qlen - 1;
+		if (jlo > jhi)
+			break;
+		hd = jlo > 0 && i > 0 ? H[jlo - 1] : NEG_INF;
+		od = jlo > 0 ? HO[jlo - 1] : 0;
+		f = NEG_INF;
+		fo = 0;
+		for (j = jlo; j <= jhi; j++)
+		{
+			/* A match or mismatch, or the start of an alignment on the first row */
+			t = target[i] > 3 || query[j] > 3 ? 0 : (target[i] == query[j] ? sa : -sb);
+			if (i == 0)
+			{
+				h = j >= dlo && j <= dhi ? t : NEG_INF;
+				o = j;
+			}
+			else
+			{
+				h = hd + t;
+				o = od;
+			}
+			hd = H[j];
+			od = HO[j];
+
+			/* A target base left out of the query */
+			e = E[j] - gape;
+			eo = EO[j];
+			if (hd - gapo - gape > e)
+			{
+				e = hd - gapo - gape;
+				eo = od;
+			}
+			if (i == 0)
+				e = NEG_INF;
+			if (e > h)
+			{
+				h = e;
+				o = eo;
+			}
+
+			/* A query base left out of the target */
+			if (f > h)
+			{
+				h = f;
+				o = fo;
+			}
+			H[j] = h;
+			HO[j] = o;
+			E[j] = e;
+			EO[j] = eo;
+			f -= gape;
+			if (h - gapo - gape > f)
+			{
+				f = h - gapo - gape;
+				fo = o;
+			}
+
+			/* Alignments end with the last base of either sequence, */
+			/* ties going to the one starting first */
+			if ((j == qlen - 1 || i == tlen - 1) &&
+			    (h > r->score || (h == r->score && o < r->query_begin)))
+			{
+				r->score = h;
+				r->query_begin = o;
+				r->query_end = j;
+				r->target_end = i;
+			}
+		}
+	}
+	if (r->score >= 0)
+		r->target_begin = 0;
+
+	return 0;
+}
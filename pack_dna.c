@@ -0,0 +1,56 @@
+/* file: pack_dna.c
+ * description: Packs a short DNA sequence into an integer hash key
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdint.h>
+#include "ddradseq.h"
+
+uint64_t pack_dna(const char *s, const size_t len)
+{
+	uint64_t key = 0;
+	uint64_t nmask = 0;
+	size_t i = 0;
+
+	if (len <= MAX_PACKED_LENGTH)
+	{
+		for (i = 0; i < len; i++)
+		{
+			switch (s[i])
+			{
+				case 'A':
+					break;
+				case 'C':
+					key |= (uint64_t)1 << (2u * i);
+					break;
+				case 'G':
+					key |= (uint64_t)2 << (2u * i);
+					break;
+				case 'T':
+					key |= (uint64_t)3 << (2u * i);
+					break;
+				case 'N':
+					nmask |= (uint64_t)1 << i;
+					break;
+				default:
+					goto escape;
+			}
+		}
+		return key | nmask << (2u * MAX_PACKED_LENGTH) |
+		       (uint64_t)len << (3u * MAX_PACKED_LENGTH);
+	}
+
+escape:
+	/* Anything else gets a flagged FNV-1a hash, to be checked against the string */
+	key = 0xcbf29ce484222325ULL;
+	for (i = 0; i < len; i++)
+	{
+		key ^= (unsigned char)s[i];
+		key *= 0x100000001b3ULL;
+	}
+
+	return key | PACK_ESCAPE;
+}
@@ -0,0 +1,112 @@
+/* file: pack_readkey.c
+ * description: Packs the mate-pair key of an Illumina identifier into an integer
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ddradseq.h"
+
+/* Widths of the packed key fields; the prefix number takes the six bits above them */
+#define Y_BITS 20
+#define X_BITS 18
+#define TILE_BITS 15
+#define LANE_BITS 4
+#define PREFIX_SHIFT (LANE_BITS + TILE_BITS + X_BITS + Y_BITS)
+
+/* Function prototypes */
+static int split_key(const char *key, const size_t len, size_t *plen, uint64_t *coord);
+static int parse_field(const char **p, const char *end, const char delim, const int bits,
+                       uint64_t *v);
+
+int pack_readkey(const READ_PREFIXES *rp, const char *key, const size_t len, uint64_t *packed)
+{
+	int i = 0;
+	size_t plen = 0;
+	uint64_t coord = 0;
+
+	/* Key is run:flowcell:lane:tile:x:y; the first two fields are numbered separately */
+	if (split_key(key, len, &plen, &coord))
+		return 1;
+	for (i = rp->n - 1; i >= 0; i--)
+	{
+		if (rp->len[i] == plen && memcmp(rp->prefix[i], key, plen) == 0)
+		{
+			*packed = coord | (uint64_t)i << PREFIX_SHIFT;
+			return 0;
+		}
+	}
+
+	return PREFIX_UNKNOWN;
+}
+
+int add_readprefix(READ_PREFIXES *rp, const char *key, const size_t len)
+{
+	size_t plen = 0;
+	uint64_t coord = 0;
+
+	if (rp->n == MAX_READ_PREFIXES || split_key(key, len, &plen, &coord))
+		return 1;
+	rp->prefix[rp->n] = strndup(key, plen);
+	if (UNLIKELY(!rp->prefix[rp->n]))
+		return 1;
+	rp->len[rp->n++] = plen;
+
+	return 0;
+}
+
+static int split_key(const char *key, const size_t len, size_t *plen, uint64_t *coord)
+{
+	const char *end = key + len;
+	const char *p = NULL;
+	uint64_t lane = 0;
+	uint64_t tile = 0;
+	uint64_t x = 0;
+	uint64_t y = 0;
+
+	p = memchr(key, ':', len);
+	if (!p)
+		return 1;
+	p = memchr(p + 1, ':', end - p - 1);
+	if (!p)
+		return 1;
+	*plen = p - key;
+	p++;
+
+	if (parse_field(&p, end, ':', LANE_BITS, &lane) ||
+	    parse_field(&p, end, ':', TILE_BITS, &tile) ||
+	    parse_field(&p, end, ':', X_BITS, &x) ||
+	    parse_field(&p, end, '\0', Y_BITS, &y))
+		return 1;
+	*coord = lane << (TILE_BITS + X_BITS + Y_BITS) | tile << (X_BITS + Y_BITS) |
+	         x << Y_BITS | y;
+
+	return 0;
+}
+
+static int parse_field(const char **p, const char *end, const char delim, const int bits,
+                       uint64_t *v)
+{
+	const char *s = *p;
+	uint64_t n = 0;
+
+	/* Only canonical decimal numbers pack without loss */
+	if (s == end || *s < '0' || *s > '9' || (*s == '0' && s + 1 < end && s[1] != delim))
+		return 1;
+	for (; s < end && *s >= '0' && *s <= '9'; s++)
+	{
+		n = n * 10u + (uint64_t)(*s - '0');
+		if (n >> bits)
+			return 1;
+	}
+	if (delim == '\0' ? s != end : (s == end || *s != delim))
+		return 1;
+	*v = n;
+	*p = s + 1;
+
+	return 0;
+}
@@ -11,14 +11,25 @@
 #include <string.h>
 #include "ddradseq.h"
 
+/* Limits shared out between the samples paired at once */
+typedef struct pair_limits_t
+{
+	size_t max_mem;                      /**< Memory budget in bytes of one sample. */
+	int max_runs;                        /**< Sorted runs of one file kept open. */
+} PAIR_LIMITS;
+
+/* Function prototypes */
+static int pair_sample(const CMD *cp, BGZF_POOL *bp, const char *fin, const char *rin, void *arg);
+
 int pair_main(const CMD *cp)
 {
-	char *pch = NULL;
 	char **filelist = NULL;
 	int ret = 0;
 	unsigned int i = 0;
 	unsigned int nfiles = 0;
 	FILE *lf = cp->lf;
+	BGZF_POOL *bp = NULL;
+	PAIR_LIMITS pl;
 
 	/* Get list of all files */
 	nfiles = traverse_dirtree(cp, __func__, &filelist);
@@ -28,77 +39,133 @@ int pair_main(const CMD *cp)
 	if (nfiles < 1)
 	{
 		logerror(lf, "%s:%d No input fastQ files found.\n", __func__, __LINE__);
-		return 1;
+		ret = 1;
+		goto cleanup;
 	}
 
-	for (i = 0; i < nfiles; i += 2)
+	/* Output blocks are compressed while the next entries are processed; */
+	/* each sample run at once writes two files */
+	bp = bgzf_pool_init(cp->nthreads, 2 * sample_workers(cp, nfiles), lf);
+	if (!bp)
 	{
-		khash_t(fastq) *h = NULL;
-		char *ffor = NULL;
-		char *frev = NULL;
-		size_t spn = 0;
-
-		/* Construct output file names */
-		ffor = strdup(filelist[i]);
-		if (UNLIKELY(!ffor))
-		{
-			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-			return 1;
-		}
-		frev = strdup(filelist[i+1]);
-		if (UNLIKELY(!frev))
-		{
-			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-			return 1;
-		}
-		pch = strstr(ffor, "parse");
-		if (!pch)
-			return 1;
-		strncpy(pch, "pairs", DNAME_LENGTH);
-		pch = strstr(frev, "parse");
-		if (!pch)
-			return 1;
-		strncpy(pch, "pairs", DNAME_LENGTH);
-
-		/* Double-check that files are mates */
-		spn = strcspn(ffor, ".");
-		ret = strncmp(ffor, frev, spn);
-		if (ret)
-		{
-			logerror(lf, "%s:%d Files \'%s\' and \'%s\' do not appear to be mate-"
-				     "pairs.\n", __func__, __LINE__, ffor, frev);
-			return 1;
-		}
-
-		/* Read forward fastQ file into hash table */
-		h = fastq_to_db(filelist[i], lf);
-		if (!h)
-			return 1;
-
-		/* Print informational update to log file */
-		loginfo(lf, "Attempting to pair files \'%s\' and \'%s\'.\n", ffor, frev);
-
-		/* Align mated pairs and write to output file*/
-		ret = pair_mates(filelist[i + 1], h, ffor, frev, lf);
-		if (ret)
-			return 1;
-
-		/* Free allocated memory */
-		free(ffor);
-		free(frev);
-		free_pairdb(h);
+		ret = 1;
+		goto cleanup;
 	}
 
+	/* Samples paired at once share the memory budget and descriptor limit */
+	pl.max_mem = cp->max_mem / sample_workers(cp, nfiles);
+	pl.max_runs = sort_run_limit(sample_workers(cp, nfiles), lf);
+	ret = run_samples(cp, bp, filelist, nfiles, pair_sample, &pl);
+	if (ret)
+		goto cleanup;
+
 	/* Print informational message to logfile */
 	if (string_equal(cp->mode, "pair"))
 		loginfo(lf, "Done pairing all fastQ files in \'%s\'.\n", cp->parent_indir);
 	else
 		loginfo(lf, "Done pairing all fastQ files in \'%s\'.\n", cp->outdir);
 
+cleanup:
 	/* Deallocate memory */
+	bgzf_pool_destroy(bp);
 	for (i = 0; i < nfiles; i++)
 		free(filelist[i]);
 	free(filelist);
 
-	return 0;
+	return ret ? 1 : 0;
+}
+
+static int pair_sample(const CMD *cp, BGZF_POOL *bp, const char *fin, const char *rin, void *arg)
+{
+	char *pch = NULL;
+	char *ffor = NULL;
+	char *frev = NULL;
+	int ret = 0;
+	size_t spn = 0;
+	const PAIR_LIMITS *pl = (const PAIR_LIMITS*)arg;
+	FILE *lf = cp->lf;
+	READ_TABLE *h = NULL;
+	ARENA *ar = NULL;
+
+	/* Construct output file names */
+	ffor = strdup(fin);
+	if (UNLIKELY(!ffor))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		ret = 1;
+		goto cleanup;
+	}
+	frev = strdup(rin);
+	if (UNLIKELY(!frev))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		ret = 1;
+		goto cleanup;
+	}
+	pch = strstr(ffor, "parse");
+	if (!pch)
+	{
+		ret = 1;
+		goto cleanup;
+	}
+	strncpy(pch, "pairs", DNAME_LENGTH);
+	pch = strstr(frev, "parse");
+	if (!pch)
+	{
+		ret = 1;
+		goto cleanup;
+	}
+	strncpy(pch, "pairs", DNAME_LENGTH);
+
+	/* Double-check that files are mates */
+	spn = strcspn(ffor, ".");
+	ret = strncmp(ffor, frev, spn);
+	if (ret)
+	{
+		logerror(lf, "%s:%d Files \'%s\' and \'%s\' do not appear to be mate-"
+			     "pairs.\n", __func__, __LINE__, ffor, frev);
+		goto cleanup;
+	}
+
+	/* Print informational update to log file */
+	loginfo(lf, "Attempting to pair files \'%s\' and \'%s\'.\n", ffor, frev);
+
+	/* Co-sorted mates are paired as both files are streamed */
+	if (cp->window > 0)
+		ret = merge_mates(fin, rin, ffor, frev, cp->window, pl->max_mem, bp, lf);
+	else
+	{
+		/* Read forward fastQ file into hash table */
+		ar = arena_init();
+		if (UNLIKELY(!ar))
+		{
+			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+			ret = 1;
+			goto cleanup;
+		}
+		ret = fastq_to_db(fin, pl->max_mem, ar, &h, lf);
+
+		/* Align mated pairs and write to output file*/
+		if (ret == 0)
+			ret = pair_mates(rin, h, ffor, frev, bp, lf);
+	}
+
+	/* Samples too large for the memory budget are paired from sorted runs */
+	if (ret == MEM_EXCEEDED)
+	{
+		arena_destroy(ar);
+		ar = NULL;
+		ret = sort_mates(fin, rin, ffor, frev, pl->max_mem, pl->max_runs, bp, lf);
+	}
+
+cleanup:
+	/* Free allocated memory */
+	free(ffor);
+	free(frev);
+	if (h)
+		free_pairdb(h, ar);
+	else
+		arena_destroy(ar);
+
+	return ret ? 1 : 0;
 }
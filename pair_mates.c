@@ -8,65 +8,34 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <stddef.h>
 #include <string.h>
-#include <zlib.h>
 #include <errno.h>
 #include "ddradseq.h"
 #include "khash.h"
 
 extern int errno;
 
-int pair_mates(const char *filename, const khash_t(fastq) *h, const char *ffor,
-               const char *frev, FILE *lf)
+int pair_mates(const char *filename, const READ_TABLE *h, const char *ffor,
+               const char *frev, BGZF_POOL *bp, FILE *lf)
 {
-	char **buf = NULL;
-	char *idline = NULL;
-	char *mkey = NULL;
-	char *pstart = NULL;
-	char *pend = NULL;
+	const char *key = NULL;
 	char *errstr = NULL;
-	int i = 0;
-	size_t l = 0;
-	size_t lc = 0;
-	size_t pos = 0;
-	size_t strl = 0;
-	ptrdiff_t plen = 0;
-	khint_t k = 0;
-	gzFile in;
-	gzFile fout;
-	gzFile rout;
-	FASTQ *e = NULL;
-
-	/* Allocate memory for buffer from heap */
-	buf = malloc(BSIZE * sizeof(char*));
-	if (UNLIKELY(!buf))
-	{
-		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-		return 1;
-	}
-	for (i = 0; i < BSIZE; i++)
-	{
-		buf[i] = malloc(MAX_LINE_LENGTH);
-		if (UNLIKELY(!buf[i]))
-		{
-			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-			return 1;
-		}
-	}
+	int ret = 0;
+	size_t klen = 0;
+	void **slot = NULL;
+	BGZF *fout = NULL;
+	BGZF *rout = NULL;
+	FASTQ_VIEW *e = NULL;
+	FASTQ_READER *fr = NULL;
+	FASTQ_VIEW v;
 
 	/* Open the fastQ input stream */
-	in = gzopen(filename, "rb");
-	if (!in)
-	{
-		errstr = strerror(errno);
-		logerror(lf, "%s:%d Unable to open input file \'%s\': %s.\n", __func__, __LINE__,
-		         filename, errstr);
+	fr = fqreader_open(filename, lf);
+	if (!fr)
 		return 1;
-	}
 
 	/* Open the output fastQ file streams */
-	fout = gzopen(ffor, "wb");
+	fout = bgzf_open(ffor, bp, lf);
 	if (!fout)
 	{
 		errstr = strerror(errno);
@@ -75,7 +44,7 @@ int pair_mates(const char *filename, const khash_t(fastq) *h, const char *ffor,
 		return 1;
 	}
 
-	rout = gzopen(frev, "wb");
+	rout = bgzf_open(frev, bp, lf);
 	if (!rout)
 	{
 		errstr = strerror(errno);
@@ -84,87 +53,30 @@ int pair_mates(const char *filename, const khash_t(fastq) *h, const char *ffor,
 		return 1;
 	}
 
-	/* Enter data from the fastQ input file into the database */
-	while (1)
+	/* Look up the mate of each reverse entry */
+	while ((ret = fqreader_next(fr, &v)) > 0)
 	{
-		/* Fill up the buffer */
-		for (lc = 0; lc < BSIZE; lc++)
+		/* Parse Illumina identifier line and lookup the mate */
+		key = fastq_key(&v, &klen);
+		if (!key)
 		{
-			/* Clear the buffer */
-			memset(buf[lc], 0, MAX_LINE_LENGTH);
-
-			/* Get line from the fastQ input stream */
-			if (gzgets(in, buf[lc], MAX_LINE_LENGTH) == Z_NULL)
-				break;
+			logerror(lf, "%s:%d fastQ header parsing error.\n", __func__, __LINE__);
+			return 1;
 		}
+		slot = readtab_get(h, key, klen);
+		e = slot ? *slot : NULL;
 
-		/* Iterate through lines in the buffer */
-		for (l = 0; l < lc; l++)
+		if (e != NULL)
 		{
-			/* We are at the end of one fastQ entry */
-			if (l % 4 == 3)
-			{
-				/* Parse entry identifier */
-				pos = strcspn(buf[l-3], "\n");
-				buf[l-3][pos] = '\0';
-				strl = strlen(&buf[l-3][1]);
-
-				/* Construct fastQ hash key */
-				idline = malloc(strl + 1u);
-				if (UNLIKELY(!idline))
-				{
-					logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-					return 1;
-				}
-				strcpy(idline, &buf[l-3][1]);
-
-				/* Parse Illumina identifier line and construct hash key */
-				pstart = strchr(idline, ':');
-				pend = strchr(idline, ' ');
-				plen = pend - pstart;
-				mkey = strndup(pstart+1, plen - 1);
-				if (UNLIKELY(!mkey))
-				{
-					logerror(lf, "%s:%d fastQ header parsing error.\n", __func__, __LINE__);
-					return 1;
-				}
-				k = kh_get(fastq, h, mkey);
-				if (k != kh_end(h))
-					e = kh_value(h, k);
-				free(mkey);
-				free(idline);
-
-				if (e != NULL)
-				{
-					/* Parse DNA sequence */
-					pos = strcspn(buf[l-2], "\n");
-					buf[l-2][pos] = '\0';
-
-					/* Parse quality sequence */
-					pos = strcspn(buf[l], "\n");
-					buf[l][pos] = '\0';
-
-					/* Need to construct output file streams */
-					gzprintf(fout, "@%s\n%s\n+\n%s\n", e->id, e->seq, e->qual);
-					gzprintf(rout, "@%s\n%s\n+\n%s\n", &buf[l-3][1], &buf[l-2][0], &buf[l][0]);
-				}
-			}
+			bgzf_write_fastq(fout, e);
+			bgzf_write_fastq(rout, &v);
 		}
-
-		/* If we are at the end of the file */
-		if (lc < BSIZE)
-			break;
 	}
 
-	/* Free memory for buffer to heap */
-	for (i = 0; i < BSIZE; i++)
-		free(buf[i]);
-	free(buf);
-
-	/* Close input stream */
-	gzclose(in);
-	gzclose(fout);
-	gzclose(rout);
+	/* Close the file streams */
+	fqreader_close(fr);
+	if (bgzf_close(fout) | bgzf_close(rout))
+		ret = -1;
 
-	return 0;
+	return ret < 0 ? 1 : 0;
 }
@@ -1,7 +1,7 @@
 /* file: parse_fastq.c
  * description: Parses a fastQ file by index sequence
  * author: Daniel Garrigan Lummei Analytics LLC
- * updated: November 2016
+ * updated: October 2026
  * email: dgarriga@lummei.net
  * copyright: MIT license
  */
@@ -9,121 +9,88 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <zlib.h>
-#include <errno.h>
 #include "khash.h"
 #include "ddradseq.h"
 
-extern int errno;
-
-int parse_fastq(const CMD *cp, const int orient, const char *filename, khash_t(pool_hash) *h,
-                khash_t(mates) *m)
+int parse_fastq(const CMD *cp, const int orient, const char *ffor, const char *frev,
+                khash_t(pool_hash) *h, MATE_TABLE *m)
 {
-	char *r = NULL;
-	char *q = NULL;
-	char *errstr = NULL;
 	char buffer[BUFLEN];
+	char *rbuffer = NULL;
 	int ret = 0;
-	size_t numlines = 0;
-	size_t bytes_read = 0;
-	size_t buff_rem = 0;
-	khint_t i = 0;
-	khint_t j = 0;
-	khint_t k = 0;
-	khash_t(barcode) *b = NULL;
-	khash_t(pool) *p = NULL;
-	BARCODE *bc = NULL;
-	POOL *pl = NULL;
+	BLOCK_READER *rd = NULL;
+	PARSE_BLOCK pb;
+	POOL_MEMO memo;
+	ALIGN_WORK aw;
 	FILE *lf = cp->lf;
-	gzFile fin;
 
 	/* Print informational message to log */
-	loginfo(lf, "Parsing fastQ file \'%s\'.\n", filename);
+	if (orient == PAIRED)
+		loginfo(lf, "Parsing fastQ files \'%s\' and \'%s\' in lockstep.\n", ffor, frev);
+	else
+		loginfo(lf, "Parsing fastQ file \'%s\'.\n", ffor);
 
-	/* Open input file */
-	fin = gzopen(filename, "rb");
-	if (!fin)
-	{
-		errstr = strerror(errno);
-		logerror(lf, "%s:%d Unable to open file \'%s\': %s.\n", __func__, __LINE__,
-		         filename, errstr);
+	/* Open input file(s) */
+	rd = reader_open(ffor, orient == PAIRED ? frev : NULL, lf);
+	if (!rd)
 		return 1;
-	}
 
-	/* Initialize buffer */
-	memset(buffer, 0, sizeof(buffer));
-	r = &buffer[0];
-
-	/* Iterate through blocks from input fastQ file */
-	while (1)
+	if (cp->mt_mode)
 	{
-		/* Read block from file into input buffer */
-		bytes_read = gzread(fin, &buffer[buff_rem], BUFLEN - buff_rem - 1);
-		if (bytes_read < 0)
-		{
-			logerror(lf, "%s:%d Failed to read data from file \'%s\': %s.\n",
-			         __func__, __LINE__, filename);
-			return 1;
-		}
-		/* Set null terminating character on input buffer */
-		buffer[bytes_read + buff_rem] = '\0';
-
-		/* Count lines in input buffer */
-		q = &buffer[0];
-		numlines = count_lines(q);
-		r = clean_buffer(q, &numlines);
-		if (orient == FORWARD)
-			ret = parse_forwardbuffer(cp, q, numlines, h, m);
-		else
-			ret = parse_reversebuffer(cp, q, numlines, h, m);
+		/* Hand blocks to the parse threads */
+		ret = parse_fastq_mt(cp, orient, rd, h, m);
 		if (ret)
 			return 1;
-		buff_rem = reset_buffer(q, r);
-
-		/* Check if we are at the end of file */
-		if (gzeof(fin))
-			break;
 	}
-
-	/* Flush remaining data in buffers */
-	for (i = kh_begin(h); i != kh_end(h); i++)
+	else
 	{
-		if (kh_exist(h, i))
+		/* Initialize buffers */
+		pb.buffer = &buffer[0];
+		pb.rbuffer = NULL;
+		memset(&memo, 0, sizeof(POOL_MEMO));
+		memset(&aw, 0, sizeof(ALIGN_WORK));
+		if (orient == PAIRED)
 		{
-			p = kh_value(h, i);
-			for (j = kh_begin(p); j != kh_end(p); j++)
+			rbuffer = malloc(BUFLEN);
+			if (UNLIKELY(!rbuffer))
 			{
-				if (kh_exist(p, j))
-				{
-					pl = kh_value(p, j);
-					b = pl->b;
-					for (k = kh_begin(b); k != kh_end(b); k++)
-					{
-						if (kh_exist(b, k))
-						{
-							bc = kh_value(b, k);
-							if (bc->curr_bytes > 0)
-							{
-								ret = flush_buffer(orient, bc, lf);
-								if (ret)
-								{
-									logerror(lf, "%s:%d Problem writing buffer to file.\n",
-									         __func__, __LINE__);
-									return 1;
-								}
-							}
-						}
-					}
-				}
+				logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+				return 1;
 			}
+			pb.rbuffer = rbuffer;
+		}
+
+		/* Iterate through blocks from input fastQ file(s) */
+		while ((ret = read_block(rd, &pb, lf)) > 0)
+		{
+			if (orient == FORWARD)
+				ret = parse_forwardbuffer(cp, pb.buffer, pb.nlines, h, m, &memo);
+			else if (orient == REVERSE)
+				ret = parse_reversebuffer(cp, pb.buffer, pb.nlines, m);
+			else
+				ret = parse_pairbuffer(cp, pb.buffer, pb.rbuffer, pb.nlines, h, &memo, &aw);
+			if (ret)
+				return 1;
 		}
+		if (ret < 0)
+			return 1;
+		free(rbuffer);
+		align_work_free(&aw);
 	}
 
-	/* Close input file */
-	gzclose(fin);
+	/* Flush remaining data in buffers */
+	ret = flush_db(orient, h, lf);
+	if (ret)
+		return 1;
+
+	/* Close input file(s) */
+	reader_close(rd);
 
 	/* Print informational message to log */
-	loginfo(lf, "Successfully parsed fastQ file \'%s\'.\n", filename);
+	if (orient == PAIRED)
+		loginfo(lf, "Successfully parsed fastQ files \'%s\' and \'%s\'.\n", ffor, frev);
+	else
+		loginfo(lf, "Successfully parsed fastQ file \'%s\'.\n", ffor);
 
 	return 0;
 }
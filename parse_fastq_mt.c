@@ -0,0 +1,161 @@
+/* file: parse_fastq_mt.c
+ * description: Parses blocks of fastQ entries using multiple threads
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "khash.h"
+#include "ddradseq.h"
+
+/* Arguments shared by all parse worker threads */
+typedef struct parse_worker_t
+{
+	const CMD *cp;
+	int orient;
+	const khash_t(pool_hash) *h;
+	MATE_TABLE *m;
+	WORK_QUEUE *full;
+	WORK_QUEUE *empty;
+	atomic_bool failed;
+} PARSE_WORKER;
+
+/* Function prototypes */
+static void *parse_worker(void *arg);
+
+int parse_fastq_mt(const CMD *cp, const int orient, BLOCK_READER *rd, khash_t(pool_hash) *h,
+                   MATE_TABLE *m)
+{
+	int ret = 0;
+	int t = 0;
+	int nworkers = cp->nthreads;
+	int nstarted = 0;
+	int nblocks = 0;
+	PARSE_BLOCK *blocks = NULL;
+	PARSE_BLOCK *pb = NULL;
+	PARSE_WORKER w;
+	pthread_t *tid = NULL;
+	FILE *lf = cp->lf;
+
+	/* Allocate enough blocks to keep every worker busy while */
+	/* the reader decompresses the next one */
+	nblocks = 2 * nworkers + 1;
+	blocks = calloc(nblocks, sizeof(PARSE_BLOCK));
+	tid = malloc(nworkers * sizeof(pthread_t));
+	w.full = queue_init(nblocks);
+	w.empty = queue_init(nblocks);
+	atomic_init(&w.failed, false);
+	if (UNLIKELY(!blocks || !tid || !w.full || !w.empty))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		atomic_store(&w.failed, true);
+		goto cleanup;
+	}
+	for (t = 0; t < nblocks; t++)
+	{
+		blocks[t].buffer = malloc(BUFLEN);
+		if (orient == PAIRED)
+			blocks[t].rbuffer = malloc(BUFLEN);
+		if (UNLIKELY(!blocks[t].buffer || (orient == PAIRED && !blocks[t].rbuffer)))
+		{
+			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+			atomic_store(&w.failed, true);
+			goto cleanup;
+		}
+		queue_push(w.empty, &blocks[t]);
+	}
+
+	/* Start the worker threads */
+	w.cp = cp;
+	w.orient = orient;
+	w.h = h;
+	w.m = m;
+	for (nstarted = 0; nstarted < nworkers; nstarted++)
+	{
+		ret = pthread_create(&tid[nstarted], NULL, parse_worker, &w);
+		if (ret)
+		{
+			logerror(lf, "%s:%d Failed to create parse thread: %s.\n", __func__,
+			         __LINE__, strerror(ret));
+			atomic_store(&w.failed, true);
+			break;
+		}
+	}
+
+	/* The calling thread decompresses the input and hands */
+	/* blocks of whole fastQ entries to the workers */
+	while (!atomic_load(&w.failed) && (pb = queue_pop(w.empty)) != NULL)
+	{
+		ret = read_block(rd, pb, lf);
+		if (ret <= 0)
+		{
+			if (ret < 0)
+				atomic_store(&w.failed, true);
+			break;
+		}
+		queue_push(w.full, pb);
+	}
+
+	/* Wait for the workers that were started to drain the queue */
+	queue_close(w.full);
+	for (t = 0; t < nstarted; t++)
+		pthread_join(tid[t], NULL);
+
+cleanup:
+	/* Free memory from the heap */
+	if (blocks)
+	{
+		for (t = 0; t < nblocks; t++)
+		{
+			free(blocks[t].buffer);
+			free(blocks[t].rbuffer);
+		}
+	}
+	free(blocks);
+	free(tid);
+	queue_destroy(w.full);
+	queue_destroy(w.empty);
+
+	return atomic_load(&w.failed) ? 1 : 0;
+}
+
+static void *parse_worker(void *arg)
+{
+	int ret = 0;
+	PARSE_WORKER *w = (PARSE_WORKER*)arg;
+	PARSE_BLOCK *pb = NULL;
+	POOL_MEMO memo;
+	ALIGN_WORK aw;
+
+	/* Each thread remembers the pools it has resolved and keeps its alignment buffers */
+	memset(&memo, 0, sizeof(POOL_MEMO));
+	memset(&aw, 0, sizeof(ALIGN_WORK));
+
+	while ((pb = queue_pop(w->full)) != NULL)
+	{
+		/* Keep draining the queue after a failure so the reader never blocks */
+		if (!atomic_load(&w->failed))
+		{
+			if (w->orient == FORWARD)
+				ret = parse_forwardbuffer(w->cp, pb->buffer, pb->nlines, w->h, w->m, &memo);
+			else if (w->orient == REVERSE)
+				ret = parse_reversebuffer(w->cp, pb->buffer, pb->nlines, w->m);
+			else
+				ret = parse_pairbuffer(w->cp, pb->buffer, pb->rbuffer, pb->nlines, w->h, &memo,
+				                       &aw);
+			if (ret)
+				atomic_store(&w->failed, true);
+		}
+		queue_push(w->empty, pb);
+	}
+	align_work_free(&aw);
+
+	return NULL;
+}
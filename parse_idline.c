@@ -0,0 +1,42 @@
+/* file: parse_idline.c
+ * description: Locates the mate key, flow cell and index fields of an Illumina identifier line
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <string.h>
+#include "ddradseq.h"
+
+int parse_idline(const char *idline, const size_t len, ILLUMINA_ID *id)
+{
+	const char *end = idline + len;
+	const char *pstart = NULL;
+	const char *pend = NULL;
+
+	/* Mate key runs from the first colon to the first space */
+	pstart = memchr(idline, ':', len);
+	pend = memchr(idline, ' ', len);
+	if (!pstart || !pend || pend < pstart)
+		return 1;
+	id->key = pstart + 1;
+	id->key_len = pend - id->key;
+
+	/* Flow cell identifier is the third colon-delimited field */
+	pstart = memchr(id->key, ':', pend - id->key);
+	if (!pstart)
+		return 1;
+	id->flowcell = pstart + 1;
+	pend = memchr(id->flowcell, ':', end - id->flowcell);
+	if (!pend)
+		return 1;
+	id->flowcell_len = pend - id->flowcell;
+
+	/* Index sequence follows the last colon */
+	for (pstart = end - 1; pstart > idline && *pstart != ':'; pstart--);
+	id->index = pstart + 1;
+	id->index_len = end - id->index;
+
+	return 0;
+}
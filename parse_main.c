@@ -18,7 +18,7 @@ int parse_main(const CMD *cp)
 	unsigned int i = 0;
 	unsigned int nfiles = 0;
 	khash_t(pool_hash) *h = NULL;
-	khash_t(mates) *m = NULL;
+	MATE_TABLE *m = NULL;
 	FILE *lf = cp->lf;
 
 	/* Check the integrity of the CSV input database file */
@@ -44,10 +44,14 @@ int parse_main(const CMD *cp)
 	if (ret)
 		return 1;
 
-	/* Initialize hash for mate pair information */
-	m = kh_init(mates);
-	if (!m)
-		return 1;
+	/* Initialize table for mate pair information */
+	/* Not needed when both mates are parsed together */
+	if (!cp->lockstep)
+	{
+		m = mate_table_init(h);
+		if (!m)
+			return 1;
+	}
 
 	/* Get list of all files */
 	nfiles = traverse_dirtree(cp, __func__, &filelist);
@@ -91,15 +95,25 @@ int parse_main(const CMD *cp)
 		/* Print informational update to log file */
 		loginfo(lf, "Deciphering mate-pair information for \'%s\' and \'%s\'.\n", ffor, frev);
 
-		/* Read the forward fastQ input file */
-		ret = parse_fastq(cp, FORWARD, ffor, h, m);
-		if (ret)
-			return 1;
-
-		/* Read the reverse fastQ input file */
-		ret = parse_fastq(cp, REVERSE, frev, h, m);
-		if (ret)
-			return 1;
+		if (cp->lockstep)
+		{
+			/* Read forward and reverse fastQ input files together */
+			ret = parse_fastq(cp, PAIRED, ffor, frev, h, NULL);
+			if (ret)
+				return 1;
+		}
+		else
+		{
+			/* Read the forward fastQ input file */
+			ret = parse_fastq(cp, FORWARD, ffor, NULL, h, m);
+			if (ret)
+				return 1;
+
+			/* Read the reverse fastQ input file */
+			ret = parse_fastq(cp, REVERSE, frev, NULL, h, m);
+			if (ret)
+				return 1;
+		}
 		free(ffor);
 		free(frev);
 	}
@@ -109,7 +123,8 @@ int parse_main(const CMD *cp)
 		free(filelist[i]);
 	free(filelist);
 	free_db(h);
-	free_matedb(m);
+	if (m)
+		free_matedb(m);
 
 	/* Print informational message to log */
 	loginfo(lf, "Parse step of pipeline is complete.\n");
@@ -0,0 +1,99 @@
+/* file: parse_pairbuffer.c
+ * description: Parses mate-paired fastQ entries from forward and reverse buffers read in lockstep
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include "khash.h"
+#include "ddradseq.h"
+
+int parse_pairbuffer(const CMD *cp, char *fbuff, char *rbuff, const size_t nl,
+                     const khash_t(pool_hash) *h, POOL_MEMO *memo, ALIGN_WORK *aw)
+{
+	char *qf = fbuff;
+	char *qr = rbuff;
+	int ret = 0;
+	size_t fadd_bytes = 0;
+	size_t radd_bytes = 0;
+	size_t bl = 0;
+	size_t l = 0;
+	size_t rlen = 0;
+	BARCODE *bc = NULL;
+	FASTQ_VIEW fv;
+	FASTQ_VIEW rv;
+	ILLUMINA_ID fid;
+	ILLUMINA_ID rid;
+	FILE *lf = cp->lf;
+
+	/* Iterate through mate-pairs in the buffers */
+	for (l = 0; l + 3u < nl; l += 4)
+	{
+		qf = tokenize_fastq(qf, &fv);
+		qr = tokenize_fastq(qr, &rv);
+
+		/* Parse Illumina identifier lines */
+		if (parse_idline(fv.id, fv.id_len, &fid) || parse_idline(rv.id, rv.id_len, &rid))
+		{
+			logerror(lf, "%s:%d fastQ header parsing error.\n", __func__, __LINE__);
+			return 1;
+		}
+
+		/* Both files must list the mates in the same order */
+		if (fid.key_len != rid.key_len || memcmp(fid.key, rid.key, fid.key_len) != 0)
+		{
+			logerror(lf, "%s:%d Entries \'%.*s\' and \'%.*s\' are not mates. Input files "
+			         "must be co-sorted to run with \'--lockstep\'.\n", __func__, __LINE__,
+			         (int)fv.id_len, fv.id, (int)rv.id_len, rv.id);
+			return 1;
+		}
+
+		/* Find the sample from the forward flow cell, index and barcode */
+		ret = lookup_barcode(cp, h, memo, &fv, &fid, &bl, &bc);
+		if (ret)
+			return 1;
+
+		/* If barcode not found-- skip the pair */
+		if (!bc)
+			continue;
+
+		/* Trim the 3' end of the reverse mate before it is buffered */
+		if (cp->fused)
+		{
+			if (trim_mate(cp, fv.seq + bl, fv.seq_len - bl, rv.seq, &rlen, aw))
+				return 1;
+			if (rlen < rv.seq_len)
+				rv.seq_len = rlen;
+			if (rlen < rv.qual_len)
+				rv.qual_len = rlen;
+		}
+
+		/* Copy both mates straight into the sample output buffers */
+		fadd_bytes = fv.id_len + fv.seq_len + fv.qual_len - 2u * bl + 5u;
+		radd_bytes = rv.id_len + rv.seq_len + rv.qual_len + 5u;
+
+		/* Take ownership of the sample output buffers */
+		pthread_mutex_lock(&bc->lock);
+		if ((bc->curr_bytes + fadd_bytes) >= BUFLEN)
+			ret = flush_buffer(FORWARD, bc, lf);
+		if (!ret && (bc->rcurr_bytes + radd_bytes) >= BUFLEN)
+			ret = flush_buffer(REVERSE, bc, lf);
+		if (ret)
+		{
+			logerror(lf, "%s:%d Problem writing buffer to file.\n", __func__, __LINE__);
+			pthread_mutex_unlock(&bc->lock);
+			return 1;
+		}
+		bc->curr_bytes += append_fastq(bc->buffer + bc->curr_bytes, &fv, bl);
+		bc->rcurr_bytes += append_fastq(bc->rbuffer + bc->rcurr_bytes, &rv, 0);
+		pthread_mutex_unlock(&bc->lock);
+	}
+
+	return 0;
+}
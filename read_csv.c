@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <zlib.h>
 #include "khash.h"
 #include "ddradseq.h"
@@ -36,6 +37,7 @@ khash_t(pool_hash) *read_csv(const CMD *cp)
 	khash_t(pool_hash) *h = NULL;       /* Pointer to flow hash table */
 	BARCODE *bc = NULL;                 /* Pointer barcode data structure */
 	POOL *pl = NULL;                    /* Pointer to pool data structure */
+	STREAM_CACHE *sc = NULL;            /* Pointer to cache of open output streams */
 	FILE *lf = cp->lf;                  /* Pointer to log file stream */
 
 	/* Print informational message to log */
@@ -58,6 +60,11 @@ khash_t(pool_hash) *read_csv(const CMD *cp)
 	/* Initialize top-level hash */
 	h = kh_init(pool_hash);
 
+	/* All sample output streams share one cache of open files */
+	sc = stream_cache_init(lf);
+	if (!sc)
+		return NULL;
+
 	/* Read CSV and populate the database */
 	while (gzgets(in, buf, MAX_LINE_LENGTH) != Z_NULL)
 	{
@@ -113,9 +120,9 @@ khash_t(pool_hash) *read_csv(const CMD *cp)
 		}
 		strcpy(tmp, tok);
 
-		/* Put pool sequence string in second-level hash */
+		/* Put packed pool sequence in second-level hash */
 		p = kh_value(h, i);
-		j = kh_put(pool, p, tmp, &a);
+		j = kh_put(pool, p, pack_dna(tmp, strl), &a);
 
 		/* If this pool sequence is a new entry-- */
 		/* initialize a third-level hash and POOL data structure */
@@ -130,10 +137,21 @@ khash_t(pool_hash) *read_csv(const CMD *cp)
 			}
 			b = kh_init(barcode);
 			pl->b = b;
+			pl->nb = NULL;
+			pl->bb = NULL;
+			pl->index = tmp;
 			kh_value(p, j) = pl;
 		}
 		else
+		{
+			if (strcmp(kh_value(p, j)->index, tmp) != 0)
+			{
+				logerror(lf, "%s:%d Pool sequences %s and %s share a hash key.\n",
+				         __func__, __LINE__, kh_value(p, j)->index, tmp);
+				return NULL;
+			}
 			free(tmp);
+		}
 
 		/* Get pool value */
 		if ((tok = strtok_r(NULL, seps, &r)) == NULL)
@@ -234,6 +252,22 @@ khash_t(pool_hash) *read_csv(const CMD *cp)
 			}
 			bc->buffer[0] = '\0';
 			bc->curr_bytes = 0;
+			bc->rbuffer = NULL;
+			bc->rcurr_bytes = 0;
+			if (cp->lockstep)
+			{
+				bc->rbuffer = malloc(BUFLEN);
+				if (UNLIKELY(!bc->rbuffer))
+				{
+					logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+					return NULL;
+				}
+				bc->rbuffer[0] = '\0';
+			}
+			pthread_mutex_init(&bc->lock, NULL);
+			memset(&bc->fstream, 0, sizeof(OUT_STREAM));
+			memset(&bc->rstream, 0, sizeof(OUT_STREAM));
+			bc->cache = sc;
 			kh_value(b, k) = bc;
 		}
 		else
@@ -268,13 +302,48 @@ khash_t(pool_hash) *read_csv(const CMD *cp)
 			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
 			return NULL;
 		}
-		sprintf(tmp, "%s/parse/smpl_%s.R1.fq.gz", pl->poolpath, bc->smplID);
-		bc->outfile = tmp;
+		/* Mates parsed in lockstep are already paired, and also trimmed when fused */
+		if (cp->fused)
+			sprintf(tmp, "%s/final/smpl_%s.R1.fq.gz", pl->poolpath, bc->smplID);
+		else if (cp->lockstep)
+			sprintf(tmp, "%s/pairs/smpl_%s.R1.fq.gz", pl->poolpath, bc->smplID);
+		else
+			sprintf(tmp, "%s/parse/smpl_%s.R1.fq.gz", pl->poolpath, bc->smplID);
+		bc->fstream.filename = tmp;
+
+		/* Convert forward output file name to reverse */
+		tmp = strdup(tmp);
+		if (UNLIKELY(!tmp))
+		{
+			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+			return NULL;
+		}
+		tmp[strlen(tmp) - 7u] = '2';
+		bc->rstream.filename = tmp;
 	}
 
 	/* Close input CSV file stream */
 	gzclose(in);
 
+	/* Enumerate the sequences within edit distance of each pool's barcodes */
+	for (i = kh_begin(h); i != kh_end(h); i++)
+	{
+		if (kh_exist(h, i))
+		{
+			p = kh_value(h, i);
+			for (j = kh_begin(p); j != kh_end(p); j++)
+			{
+				if (kh_exist(p, j))
+				{
+					pl = kh_value(p, j);
+					pl->bb = batch_init(pl, lf);
+					if (!pl->bb || build_neighbors(pl, cp->dist, lf))
+						return NULL;
+				}
+			}
+		}
+	}
+
 	/* Print informational message to log */
 	loginfo(lf, "Successfully parsed CSV database file \'%s\'.\n", csvfile);
 
@@ -0,0 +1,155 @@
+/* file: read_table.c
+ * description: Hash of reads keyed by mate-pair key, packing Illumina keys into integers
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "khash.h"
+#include "ddradseq.h"
+
+READ_TABLE *readtab_init(void)
+{
+	READ_TABLE *rt = NULL;
+
+	rt = calloc(1, sizeof(READ_TABLE));
+	if (UNLIKELY(!rt))
+		return NULL;
+	rt->ids = kh_init(read_id);
+	rt->names = kh_init(read_name);
+	if (UNLIKELY(!rt->ids || !rt->names))
+	{
+		readtab_destroy(rt);
+		return NULL;
+	}
+
+	return rt;
+}
+
+void **readtab_put(READ_TABLE *rt, const char *key, const size_t len, int *absent)
+{
+	char name[MAX_LINE_LENGTH];
+	int ret = 0;
+	uint64_t packed = 0;
+	khint_t k = 0;
+
+	/* Number each new run and flow cell while there is room */
+	ret = pack_readkey(&rt->rp, key, len, &packed);
+	if (ret == PREFIX_UNKNOWN && add_readprefix(&rt->rp, key, len) == 0)
+		ret = pack_readkey(&rt->rp, key, len, &packed);
+	if (ret == 0)
+	{
+		k = kh_put(read_id, rt->ids, packed, absent);
+		if (UNLIKELY(*absent < 0))
+			return NULL;
+		if (*absent)
+			kh_value(rt->ids, k) = NULL;
+		return &kh_value(rt->ids, k);
+	}
+
+	/* Other identifiers are keyed by the name itself */
+	if (len >= MAX_LINE_LENGTH)
+		return NULL;
+	memcpy(name, key, len);
+	name[len] = '\0';
+	k = kh_put(read_name, rt->names, name, absent);
+	if (UNLIKELY(*absent < 0))
+		return NULL;
+	if (*absent)
+	{
+		kh_key(rt->names, k) = strdup(name);
+		kh_value(rt->names, k) = NULL;
+		if (UNLIKELY(!kh_key(rt->names, k)))
+		{
+			kh_del(read_name, rt->names, k);
+			return NULL;
+		}
+	}
+
+	return &kh_value(rt->names, k);
+}
+
+void **readtab_get(const READ_TABLE *rt, const char *key, const size_t len)
+{
+	char name[MAX_LINE_LENGTH];
+	uint64_t packed = 0;
+	khint_t k = 0;
+
+	if (pack_readkey(&rt->rp, key, len, &packed) == 0)
+	{
+		k = kh_get(read_id, rt->ids, packed);
+		return k == kh_end(rt->ids) ? NULL : &kh_value(rt->ids, k);
+	}
+
+	if (kh_size(rt->names) == 0 || len >= MAX_LINE_LENGTH)
+		return NULL;
+	memcpy(name, key, len);
+	name[len] = '\0';
+	k = kh_get(read_name, rt->names, name);
+
+	return k == kh_end(rt->names) ? NULL : &kh_value(rt->names, k);
+}
+
+void readtab_del(READ_TABLE *rt, const char *key, const size_t len)
+{
+	char name[MAX_LINE_LENGTH];
+	uint64_t packed = 0;
+	khint_t k = 0;
+
+	if (pack_readkey(&rt->rp, key, len, &packed) == 0)
+	{
+		k = kh_get(read_id, rt->ids, packed);
+		if (k != kh_end(rt->ids))
+			kh_del(read_id, rt->ids, k);
+		return;
+	}
+
+	if (len >= MAX_LINE_LENGTH)
+		return;
+	memcpy(name, key, len);
+	name[len] = '\0';
+	k = kh_get(read_name, rt->names, name);
+	if (k != kh_end(rt->names))
+	{
+		free((char*)kh_key(rt->names, k));
+		kh_del(read_name, rt->names, k);
+	}
+}
+
+size_t readtab_size(const READ_TABLE *rt)
+{
+	return kh_size(rt->ids) + kh_size(rt->names);
+}
+
+size_t readtab_bytes(const READ_TABLE *rt)
+{
+	/* Slots plus the two flag bits khash keeps for each */
+	return kh_n_buckets(rt->ids) * (sizeof(uint64_t) + sizeof(void*)) +
+	       kh_n_buckets(rt->names) * (sizeof(char*) + sizeof(void*)) +
+	       (kh_n_buckets(rt->ids) + kh_n_buckets(rt->names)) / 4u;
+}
+
+void readtab_destroy(READ_TABLE *rt)
+{
+	int i = 0;
+	khint_t k = 0;
+
+	if (!rt)
+		return;
+	if (rt->names)
+	{
+		for (k = kh_begin(rt->names); k != kh_end(rt->names); k++)
+			if (kh_exist(rt->names, k))
+				free((char*)kh_key(rt->names, k));
+		kh_destroy(read_name, rt->names);
+	}
+	if (rt->ids)
+		kh_destroy(read_id, rt->ids);
+	for (i = 0; i < rt->rp.n; i++)
+		free(rt->rp.prefix[i]);
+	free(rt);
+}
@@ -15,10 +15,36 @@
 /* Beginning of ASCII DNA sequence alphabet */
 #define DNA_BEGIN 65
 
+/* Set in rc_nt4_table for bases that revcom rejects */
+#define BAD_BASE 8
+
 /* Function prototypes */
 static int reverse_string(char*);
 static int complement_string(char*, FILE *lf);
 
+/* Globally scoped variables */
+extern const char seq_nt4_table[256];
+
+/* Code of the complement of each character, as seq_nt4_table codes it */
+static const char rc_nt4_table[256] = {
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 4, 8, 8,
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,
+  8, 3, 8, 2,  8, 8, 8, 1,  8, 8, 8, 4,  8, 4, 4, 8,
+  8, 8, 4, 4,  0, 0, 8, 4,  8, 4, 8, 8,  8, 8, 8, 8,
+  8, 3, 8, 2,  8, 8, 8, 1,  8, 8, 8, 4,  8, 4, 4, 8,
+  8, 8, 4, 4,  0, 0, 8, 4,  8, 4, 8, 8,  8, 8, 8, 8,
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,
+  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8,  8, 8, 8, 8
+};
+
 char *revcom(const char *s, FILE *lf)
 {
 	char *str = NULL;
@@ -92,9 +118,9 @@ static int complement_string(char *s, FILE *lf)
 	char *iupac = "ACGTURYSWKMN-";
 	char *iupac_extend = "BDHV";
 	size_t i = 0;
-	unsigned int lookup_table[25] = { 6u, 0u, 19u,	0u, 0u, 0u, 0u,	 0u,  0u, 0u,
-									 12u, 0u, 10u, 13u, 0u, 0u, 0u, 17u, 22u, 2u,
-									  2u, 0u, 18u,	0u, 24u};
+	unsigned int lookup_table[25] = { 19u, 0u, 6u,	0u, 0u, 0u, 2u,	 0u,  0u, 0u,
+									 12u, 0u, 10u, 13u, 0u, 0u, 0u, 24u, 18u, 0u,
+									  0u, 0u, 22u,	0u, 17u};
 
 	/* Iterate through string and complement each base */
 	for (i = 0; i < strlen(s); i++)
@@ -125,3 +151,38 @@ static int complement_string(char *s, FILE *lf)
 	}
 	return 0;
 }
+
+int revcom_code(const char *s, const int len, char *code, FILE *lf)
+{
+	char *str = NULL;
+	int i = 0;
+	int bad = 0;
+
+	/* A single base is left as it is, as long as it is a letter or a gap */
+	if (len == 1)
+	{
+		if (isalpha(s[0]) || s[0] == '-')
+		{
+			code[0] = seq_nt4_table[(unsigned char)s[0]];
+			return 0;
+		}
+		bad = BAD_BASE;
+	}
+
+	/* Complement and code each base as it is read back to front */
+	for (i = 0; i < len; i++)
+	{
+		code[i] = rc_nt4_table[(unsigned char)s[len - 1 - i]];
+		bad |= code[i];
+	}
+
+	/* A sequence revcom rejects is left to it to report */
+	if (bad & BAD_BASE)
+	{
+		str = revcom(s, lf);
+		free(str);
+		return 1;
+	}
+
+	return 0;
+}
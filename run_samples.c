@@ -0,0 +1,162 @@
+/* file: run_samples.c
+ * description: Processes sample mate pairs concurrently, largest first
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "ddradseq.h"
+
+/* One mate pair of input files and the bytes it holds */
+typedef struct sample_job_t
+{
+	unsigned int i;
+	off_t size;
+} SAMPLE_JOB;
+
+/* Arguments shared by all sample worker threads */
+typedef struct sample_worker_t
+{
+	const CMD *cp;
+	BGZF_POOL *bp;
+	char **filelist;
+	SAMPLE_FUNC fn;
+	void *arg;
+	WORK_QUEUE *jobs;
+	atomic_bool failed;
+} SAMPLE_WORKER;
+
+/* Function prototypes */
+static int job_cmp(const void *a, const void *b);
+static void *sample_worker(void *arg);
+
+int sample_workers(const CMD *cp, const unsigned int nfiles)
+{
+	int npairs = (int)(nfiles / 2u);
+
+	return npairs < cp->nthreads ? (npairs > 0 ? npairs : 1) : cp->nthreads;
+}
+
+int run_samples(const CMD *cp, BGZF_POOL *bp, char **filelist, const unsigned int nfiles,
+                SAMPLE_FUNC fn, void *arg)
+{
+	int ret = 0;
+	int t = 0;
+	int nstarted = 0;
+	int nworkers = sample_workers(cp, nfiles);
+	unsigned int i = 0;
+	unsigned int npairs = nfiles / 2u;
+	SAMPLE_JOB *order = NULL;
+	SAMPLE_WORKER w;
+	pthread_t *tid = NULL;
+	struct stat st;
+	FILE *lf = cp->lf;
+
+	/* Start the largest samples first so that none is left running alone at the end */
+	order = malloc(npairs * sizeof(SAMPLE_JOB));
+	if (UNLIKELY(!order))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return 1;
+	}
+	for (i = 0; i < npairs; i++)
+	{
+		order[i].i = 2u * i;
+		order[i].size = 0;
+		if (stat(filelist[2u * i], &st) == 0)
+			order[i].size += st.st_size;
+		if (stat(filelist[2u * i + 1u], &st) == 0)
+			order[i].size += st.st_size;
+	}
+	qsort(order, npairs, sizeof(SAMPLE_JOB), job_cmp);
+
+	w.cp = cp;
+	w.bp = bp;
+	w.filelist = filelist;
+	w.fn = fn;
+	w.arg = arg;
+	w.jobs = NULL;
+	atomic_init(&w.failed, false);
+
+	/* A single worker runs in the calling thread */
+	if (nworkers == 1)
+	{
+		for (i = 0; i < npairs && !ret; i++)
+			ret = fn(cp, bp, filelist[order[i].i], filelist[order[i].i + 1u], arg);
+		if (ret)
+			atomic_store(&w.failed, true);
+		goto cleanup;
+	}
+
+	w.jobs = queue_init(npairs);
+	tid = malloc(nworkers * sizeof(pthread_t));
+	if (UNLIKELY(!w.jobs || !tid))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		atomic_store(&w.failed, true);
+		goto cleanup;
+	}
+	for (i = 0; i < npairs; i++)
+		queue_push(w.jobs, &order[i]);
+	queue_close(w.jobs);
+
+	/* Start the worker threads and wait for the queue to drain; after a */
+	/* failed start the threads already running skip the remaining samples */
+	for (nstarted = 0; nstarted < nworkers; nstarted++)
+	{
+		ret = pthread_create(&tid[nstarted], NULL, sample_worker, &w);
+		if (ret)
+		{
+			logerror(lf, "%s:%d Failed to create sample thread: %s.\n", __func__,
+			         __LINE__, strerror(ret));
+			atomic_store(&w.failed, true);
+			break;
+		}
+	}
+	for (t = 0; t < nstarted; t++)
+		pthread_join(tid[t], NULL);
+
+cleanup:
+	/* Free memory from the heap */
+	queue_destroy(w.jobs);
+	free(tid);
+	free(order);
+
+	return atomic_load(&w.failed) ? 1 : 0;
+}
+
+static int job_cmp(const void *a, const void *b)
+{
+	const SAMPLE_JOB *x = (const SAMPLE_JOB*)a;
+	const SAMPLE_JOB *y = (const SAMPLE_JOB*)b;
+
+	/* Largest first; equal sizes keep directory order */
+	if (x->size != y->size)
+		return x->size < y->size ? 1 : -1;
+	return x->i < y->i ? -1 : (x->i > y->i);
+}
+
+static void *sample_worker(void *arg)
+{
+	SAMPLE_WORKER *w = (SAMPLE_WORKER*)arg;
+	SAMPLE_JOB *job = NULL;
+
+	/* Samples not yet started are abandoned after a failure */
+	while ((job = queue_pop(w->jobs)) != NULL)
+	{
+		if (atomic_load(&w->failed))
+			continue;
+		if (w->fn(w->cp, w->bp, w->filelist[job->i], w->filelist[job->i + 1u], w->arg))
+			atomic_store(&w->failed, true);
+	}
+
+	return NULL;
+}
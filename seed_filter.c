@@ -0,0 +1,108 @@
+/* file: seed_filter.c
+ * description: Rules out mate pairs that cannot align well enough to be trimmed
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ * note: An alignment scoring minsc needs enough matches to pay for its
+ *       mismatches and gaps, and every run of matches at least SEED_LENGTH
+ *       long shares that many seeds, so an alignment with few errors shares
+ *       many seeds between its query and target. Bounding the errors by the
+ *       score and the shorter sequence's length bounds the seeds from
+ *       below; a pair sharing fewer has no such alignment and so no trim
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "ddradseq.h"
+
+/* Seeds are exact matches of this many bases, packed two bits a base */
+#define SEED_LENGTH 6
+#define SEED_MASK ((1u << (2 * SEED_LENGTH)) - 1u)
+
+/* Function prototypes */
+static double seeds_needed(const int len, const int nambig, const int minsc, const int sa,
+                           const int sb, const int gapo, const int gape);
+
+int seed_filter(const char *query, const int qlen, const char *target, const int tlen,
+                const int minsc, const int sa, const int sb, const int gapo, const int gape)
+{
+	uint64_t seen[(SEED_MASK + 1u) / 64u];
+	uint32_t seed = 0;
+	int i = 0;
+	int run = 0;
+	int nambig = 0;
+	int nseeds = 0;
+	int len = qlen < tlen ? qlen : tlen;
+
+	/* No alignment scores more than a match for every base of the shorter sequence */
+	if (minsc <= 0 || sa <= 0)
+		return 1;
+	if (len * sa < minsc)
+		return 0;
+	if (sb < 0 || gapo < 0 || gape < 0 || gapo + gape == 0)
+		return 1;
+
+	/* Mark each seed of the target */
+	memset(seen, 0, sizeof(seen));
+	for (i = 0; i < tlen; i++)
+	{
+		if (target[i] > 3)
+		{
+			nambig++;
+			run = 0;
+			continue;
+		}
+		seed = ((seed << 2) | (uint32_t)target[i]) & SEED_MASK;
+		if (++run >= SEED_LENGTH)
+			seen[seed >> 6] |= (uint64_t)1 << (seed & 63u);
+	}
+
+	/* Count the query positions starting a seed of the target */
+	for (i = 0, run = 0; i < qlen; i++)
+	{
+		if (query[i] > 3)
+		{
+			nambig++;
+			run = 0;
+			continue;
+		}
+		seed = ((seed << 2) | (uint32_t)query[i]) & SEED_MASK;
+		if (++run >= SEED_LENGTH)
+			nseeds += (int)(seen[seed >> 6] >> (seed & 63u) & 1u);
+	}
+
+	/* Ambiguous bases score nothing against anything, so may cost no score */
+	return nseeds >= seeds_needed(len, nambig, minsc, sa, sb, gapo, gape);
+}
+
+static double seeds_needed(const int len, const int nambig, const int minsc, const int sa,
+                           const int sb, const int gapo, const int gape)
+{
+	double x = 0;
+	double g = 0;
+	double need = 0;
+	double f = 0;
+	const int k = SEED_LENGTH;
+
+	/* With x mismatches and g gaps at least (minsc + sb*x + (gapo+gape)*g)/sa */
+	/* matches fall in at most x + g + nambig + 1 runs, each sharing all but */
+	/* k - 1 of its matches as seeds. This is linear in x and g, so its least */
+	/* value over the alignments that fit in len bases is at a corner */
+	need = (double)minsc / sa - (k - 1) * (1.0 + nambig);
+
+	/* Most mismatches, each column holding a match or a mismatch */
+	x = (double)(len * sa - minsc) / (sa + sb);
+	f = len - k * x - (k - 1) * (1.0 + nambig);
+	if (f < need)
+		need = f;
+
+	/* Most gaps, every other column holding a match between them */
+	g = (double)(len * sa - minsc) / (gapo + gape);
+	f = len - (k - 1) * (g + 1.0 + nambig);
+	if (f < need)
+		need = f;
+
+	/* Shaved so rounding never rules out a pair on the boundary */
+	return need - 1e-6;
+}
@@ -0,0 +1,525 @@
+/* file: sort_mates.c
+ * description: Pairs mates out of memory by merging sorted runs of each fastQ file
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <errno.h>
+#include <zlib.h>
+#include "ddradseq.h"
+
+/* One entry held in memory while a run is built */
+typedef struct sort_entry_t
+{
+	char *data;     /* Null-delimited key, identifier, sequence and quality */
+	size_t n;       /* Position of the entry in the input file */
+} SORT_ENTRY;
+
+/* Function prototypes */
+static int spill_runs(const char *filename, SORT_RUNS *sr, const size_t max_mem, FILE *lf);
+static int write_run(SORT_RUNS *sr, SORT_ENTRY *ent, const size_t nent, FILE *lf);
+static int compact_runs(SORT_RUNS *sr, FILE *lf);
+static int open_run(SORT_RUNS *sr, gzFile *out, FILE *lf);
+static int put_entry(gzFile out, const char *id, const char *seq, const char *qual);
+static int merge_start(SORT_RUNS *sr, FILE *lf);
+static int merge_next(SORT_RUNS *sr, FASTQ_VIEW *v, const char **key, size_t *klen);
+static int read_run(SORT_RUNS *sr, const int r);
+static void close_runs(SORT_RUNS *sr);
+static int key_cmp(const char *a, const size_t alen, const char *b, const size_t blen);
+static int entry_cmp(const void *a, const void *b);
+static bool run_less(const SORT_RUNS *sr, const int a, const int b);
+static void sift_down(SORT_RUNS *sr, int i);
+
+int sort_run_limit(const int nsamples, FILE *lf)
+{
+	int max_runs = MAX_MERGE_RUNS;
+	rlim_t avail = 0;
+	struct rlimit rl;
+
+	/* Both files of every sample paired at once keep their runs open, each */
+	/* with two more descriptors for the run being written and the input or output */
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+	{
+		avail = rl.rlim_cur > FD_RESERVE ? rl.rlim_cur - FD_RESERVE : 0;
+		avail /= (rlim_t)(nsamples > 0 ? nsamples : 1) * 2u;
+		if (avail < (rlim_t)MAX_MERGE_RUNS + 2u)
+			max_runs = avail > 4u ? (int)avail - 2 : 2;
+	}
+	loginfo(lf, "Merging sorted runs once %d of a file are open.\n", max_runs);
+
+	return max_runs;
+}
+
+int sort_mates(const char *fin, const char *rin, const char *ffor, const char *frev,
+               const size_t max_mem, const int max_runs, BGZF_POOL *bp, FILE *lf)
+{
+	const char *fkey = NULL;
+	const char *rkey = NULL;
+	int c = 0;
+	int fret = 0;
+	int rret = 0;
+	int ret = 0;
+	size_t fkl = 0;
+	size_t rkl = 0;
+	size_t npairs = 0;
+	SORT_RUNS *fs = NULL;
+	SORT_RUNS *rs = NULL;
+	BGZF *fout = NULL;
+	BGZF *rout = NULL;
+	FASTQ_VIEW fv;
+	FASTQ_VIEW rv;
+
+	fs = calloc(1, sizeof(SORT_RUNS));
+	rs = calloc(1, sizeof(SORT_RUNS));
+	if (UNLIKELY(!fs || !rs))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return 1;
+	}
+
+	/* Temporary run files are kept beside the output files */
+	fs->prefix = ffor;
+	rs->prefix = frev;
+	fs->max_runs = max_runs;
+	rs->max_runs = max_runs;
+	if (spill_runs(fin, fs, max_mem, lf) || spill_runs(rin, rs, max_mem, lf))
+		return 1;
+	loginfo(lf, "Sorted mates into %d forward and %d reverse runs of at most %zu bytes.\n",
+	        fs->nruns, rs->nruns, max_mem);
+
+	/* Open the output fastQ file streams */
+	fout = bgzf_open(ffor, bp, lf);
+	if (!fout)
+	{
+		logerror(lf, "%s:%d Unable to forward output file \'%s\': %s.\n", __func__,
+		         __LINE__, ffor, strerror(errno));
+		return 1;
+	}
+	rout = bgzf_open(frev, bp, lf);
+	if (!rout)
+	{
+		logerror(lf, "%s:%d Unable to reverse output file \'%s\': %s.\n", __func__,
+		         __LINE__, frev, strerror(errno));
+		return 1;
+	}
+
+	/* Join the two key-ordered streams */
+	if (merge_start(fs, lf) || merge_start(rs, lf))
+		goto readerr;
+	fret = merge_next(fs, &fv, &fkey, &fkl);
+	rret = merge_next(rs, &rv, &rkey, &rkl);
+	while (fret > 0 && rret > 0)
+	{
+		/* The last of several forward entries with one key is its mate, as in memory */
+		while (fret > 0 && fs->nheap > 0 &&
+		       key_cmp(fs->key[fs->heap[0]], fs->klen[fs->heap[0]], fkey, fkl) == 0)
+			fret = merge_next(fs, &fv, &fkey, &fkl);
+		if (fret < 0)
+			break;
+
+		c = key_cmp(fkey, fkl, rkey, rkl);
+		if (c == 0)
+		{
+			bgzf_write_fastq(fout, &fv);
+			bgzf_write_fastq(rout, &rv);
+			npairs++;
+			rret = merge_next(rs, &rv, &rkey, &rkl);
+		}
+		else if (c < 0)
+			fret = merge_next(fs, &fv, &fkey, &fkl);
+		else
+			rret = merge_next(rs, &rv, &rkey, &rkl);
+	}
+	if (fret < 0 || rret < 0)
+		goto readerr;
+	loginfo(lf, "Paired %zu mates by merging sorted runs.\n", npairs);
+
+	/* Free memory from the heap */
+	close_runs(fs);
+	close_runs(rs);
+	free(fs);
+	free(rs);
+
+	/* Close the output streams */
+	ret = bgzf_close(fout);
+	ret |= bgzf_close(rout);
+
+	return ret;
+
+readerr:
+	logerror(lf, "%s:%d Error reading temporary run file \'%s\'.\n", __func__, __LINE__,
+	         fret < 0 ? ffor : frev);
+	return 1;
+}
+
+static int spill_runs(const char *filename, SORT_RUNS *sr, const size_t max_mem, FILE *lf)
+{
+	char *p = NULL;
+	const char *key = NULL;
+	int ret = 0;
+	size_t klen = 0;
+	size_t total = 0;
+	size_t used = 0;
+	size_t nent = 0;
+	size_t cap = 0;
+	size_t n = 0;
+	FASTQ_READER *fr = NULL;
+	SORT_ENTRY *ent = NULL;
+	SORT_ENTRY *tmp = NULL;
+	FASTQ_VIEW v;
+
+	fr = fqreader_open(filename, lf);
+	if (!fr)
+		return 1;
+
+	while ((ret = fqreader_next(fr, &v)) > 0)
+	{
+		key = fastq_key(&v, &klen);
+		if (!key)
+		{
+			logerror(lf, "%s:%d fastQ header parsing error.\n", __func__, __LINE__);
+			return 1;
+		}
+		total = klen + v.id_len + v.seq_len + v.qual_len + 4u;
+
+		/* Write out the entries held so far once the budget is spent */
+		if (nent > 0 && used + total + sizeof(SORT_ENTRY) > max_mem)
+		{
+			if (write_run(sr, ent, nent, lf))
+				return 1;
+			nent = 0;
+			used = cap * sizeof(SORT_ENTRY);
+		}
+		if (nent == cap)
+		{
+			cap = cap ? cap << 1 : 1024u;
+			tmp = realloc(ent, cap * sizeof(SORT_ENTRY));
+			if (UNLIKELY(!tmp))
+			{
+				logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+				return 1;
+			}
+			ent = tmp;
+			used += (cap >> 1) * sizeof(SORT_ENTRY);
+		}
+
+		/* Store the key, identifier, sequence and quality back to back */
+		p = malloc(total);
+		if (UNLIKELY(!p))
+		{
+			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+			return 1;
+		}
+		ent[nent].data = p;
+		ent[nent].n = n++;
+		memcpy(p, key, klen);
+		p[klen] = '\0';
+		p += klen + 1u;
+		memcpy(p, v.id, v.id_len + 1u);
+		p += v.id_len + 1u;
+		memcpy(p, v.seq, v.seq_len + 1u);
+		p += v.seq_len + 1u;
+		memcpy(p, v.qual, v.qual_len + 1u);
+		nent++;
+		used += total;
+	}
+	if (ret < 0)
+		return 1;
+	if (write_run(sr, ent, nent, lf))
+		return 1;
+
+	fqreader_close(fr);
+	free(ent);
+
+	return 0;
+}
+
+static int write_run(SORT_RUNS *sr, SORT_ENTRY *ent, const size_t nent, FILE *lf)
+{
+	const char *id = NULL;
+	const char *seq = NULL;
+	const char *qual = NULL;
+	int ret = 0;
+	size_t x = 0;
+	gzFile out;
+
+	/* Keep the number of open runs bounded */
+	if (sr->nruns >= sr->max_runs && compact_runs(sr, lf))
+		return 1;
+
+	/* Runs are written as fastQ, to be read back by key order */
+	qsort(ent, nent, sizeof(SORT_ENTRY), entry_cmp);
+	if (open_run(sr, &out, lf))
+		return 1;
+	for (x = 0; x < nent; x++)
+	{
+		id = ent[x].data + strlen(ent[x].data) + 1u;
+		seq = id + strlen(id) + 1u;
+		qual = seq + strlen(seq) + 1u;
+		ret |= put_entry(out, id, seq, qual);
+		free(ent[x].data);
+	}
+	if (gzclose(out) != Z_OK || ret)
+	{
+		logerror(lf, "%s:%d Unable to write temporary run file for \'%s\'.\n", __func__,
+		         __LINE__, sr->prefix);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int compact_runs(SORT_RUNS *sr, FILE *lf)
+{
+	const char *key = NULL;
+	int ret = 0;
+	size_t klen = 0;
+	gzFile out;
+	SORT_RUNS *old = NULL;
+	FASTQ_VIEW v;
+
+	/* Merge every run so far into one, which keeps its place in file order */
+	old = malloc(sizeof(SORT_RUNS));
+	if (UNLIKELY(!old))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return 1;
+	}
+	memcpy(old, sr, sizeof(SORT_RUNS));
+	sr->nruns = 0;
+	sr->rec = NULL;
+	sr->rec_size = 0;
+	if (open_run(sr, &out, lf))
+		return 1;
+	if (merge_start(old, lf))
+		ret = -1;
+	while (ret == 0 && (ret = merge_next(old, &v, &key, &klen)) > 0)
+		ret = put_entry(out, v.id, v.seq, v.qual) ? -1 : 0;
+	if (ret < 0 || gzclose(out) != Z_OK)
+	{
+		logerror(lf, "%s:%d Unable to merge temporary run files for \'%s\'.\n", __func__,
+		         __LINE__, sr->prefix);
+		return 1;
+	}
+	close_runs(old);
+	free(old);
+
+	return 0;
+}
+
+static int open_run(SORT_RUNS *sr, gzFile *out, FILE *lf)
+{
+	char *tmpl = NULL;
+	int fd = 0;
+	int wfd = 0;
+
+	tmpl = malloc(strlen(sr->prefix) + 8u);
+	if (UNLIKELY(!tmpl))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return 1;
+	}
+	sprintf(tmpl, "%s.XXXXXX", sr->prefix);
+
+	/* The file is removed at once and lives only as long as its descriptor */
+	fd = mkstemp(tmpl);
+	if (fd < 0)
+	{
+		logerror(lf, "%s:%d Unable to create temporary file \'%s\': %s.\n", __func__,
+		         __LINE__, tmpl, strerror(errno));
+		return 1;
+	}
+	unlink(tmpl);
+	free(tmpl);
+
+	/* Runs are written through a duplicate and read back from the start */
+	wfd = dup(fd);
+	if (wfd < 0)
+	{
+		logerror(lf, "%s:%d Unable to duplicate file descriptor: %s.\n", __func__,
+		         __LINE__, strerror(errno));
+		return 1;
+	}
+	*out = gzdopen(wfd, "wb1");
+	if (!*out)
+	{
+		logerror(lf, "%s:%d Unable to open temporary run file for \'%s\'.\n", __func__,
+		         __LINE__, sr->prefix);
+		return 1;
+	}
+	sr->fr[sr->nruns] = NULL;
+	sr->fd[sr->nruns++] = fd;
+
+	return 0;
+}
+
+static int put_entry(gzFile out, const char *id, const char *seq, const char *qual)
+{
+	/* Lines of any length are written whole */
+	if (gzputs(out, id) < 0 || gzputc(out, '\n') < 0 || gzputs(out, seq) < 0 ||
+	    gzputs(out, "\n+\n") < 0 || gzputs(out, qual) < 0 || gzputc(out, '\n') < 0)
+		return 1;
+
+	return 0;
+}
+
+static int merge_start(SORT_RUNS *sr, FILE *lf)
+{
+	int i = 0;
+	int ret = 0;
+
+	/* Load the first entry of each run and heap them by key */
+	sr->nheap = 0;
+	for (i = 0; i < sr->nruns; i++)
+	{
+		if (lseek(sr->fd[i], 0, SEEK_SET) < 0)
+			return 1;
+		sr->fr[i] = fqreader_dopen(sr->fd[i], sr->prefix, MERGE_BUFLEN, lf);
+		if (!sr->fr[i])
+			return 1;
+		ret = read_run(sr, i);
+		if (ret < 0)
+			return 1;
+		if (ret > 0)
+			sr->heap[sr->nheap++] = i;
+	}
+	for (i = sr->nheap / 2 - 1; i >= 0; i--)
+		sift_down(sr, i);
+
+	return 0;
+}
+
+static int merge_next(SORT_RUNS *sr, FASTQ_VIEW *v, const char **key, size_t *klen)
+{
+	char *p = NULL;
+	int r = 0;
+	int ret = 0;
+	size_t len = 0;
+	FASTQ_VIEW *rv = NULL;
+
+	if (sr->nheap == 0)
+		return 0;
+
+	/* Copy out the lowest entry, which must outlive the refill of its run */
+	r = sr->heap[0];
+	rv = &sr->v[r];
+	len = rv->id_len + rv->seq_len + rv->qual_len + 3u;
+	if (len > sr->rec_size)
+	{
+		p = realloc(sr->rec, len);
+		if (UNLIKELY(!p))
+			return -1;
+		sr->rec = p;
+		sr->rec_size = len;
+	}
+	p = sr->rec;
+	memcpy(p, rv->id, rv->id_len + 1u);
+	v->id = p;
+	v->id_len = rv->id_len;
+	*key = p + (sr->key[r] - rv->id);
+	*klen = sr->klen[r];
+	p += rv->id_len + 1u;
+	memcpy(p, rv->seq, rv->seq_len + 1u);
+	v->seq = p;
+	v->seq_len = rv->seq_len;
+	p += rv->seq_len + 1u;
+	memcpy(p, rv->qual, rv->qual_len + 1u);
+	v->qual = p;
+	v->qual_len = rv->qual_len;
+
+	/* Refill the run */
+	ret = read_run(sr, r);
+	if (ret < 0)
+		return -1;
+	if (ret == 0)
+		sr->heap[0] = sr->heap[--sr->nheap];
+	sift_down(sr, 0);
+
+	return 1;
+}
+
+static int read_run(SORT_RUNS *sr, const int r)
+{
+	int ret = 0;
+
+	ret = fqreader_next(sr->fr[r], &sr->v[r]);
+	if (ret <= 0)
+		return ret;
+	sr->key[r] = fastq_key(&sr->v[r], &sr->klen[r]);
+
+	return sr->key[r] ? 1 : -1;
+}
+
+static void close_runs(SORT_RUNS *sr)
+{
+	int i = 0;
+
+	for (i = 0; i < sr->nruns; i++)
+	{
+		if (sr->fr[i])
+			fqreader_close(sr->fr[i]);
+		else
+			close(sr->fd[i]);
+	}
+	free(sr->rec);
+	sr->rec = NULL;
+	sr->rec_size = 0;
+	sr->nruns = 0;
+	sr->nheap = 0;
+}
+
+static int key_cmp(const char *a, const size_t alen, const char *b, const size_t blen)
+{
+	int c = memcmp(a, b, alen < blen ? alen : blen);
+
+	/* Orders keys as strcmp would */
+	if (c)
+		return c;
+	return alen < blen ? -1 : alen > blen;
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+	const SORT_ENTRY *x = a;
+	const SORT_ENTRY *y = b;
+	int c = strcmp(x->data, y->data);
+
+	/* Entries with one key keep their file order */
+	if (c)
+		return c;
+	return x->n < y->n ? -1 : x->n > y->n;
+}
+
+static bool run_less(const SORT_RUNS *sr, const int a, const int b)
+{
+	int c = key_cmp(sr->key[a], sr->klen[a], sr->key[b], sr->klen[b]);
+
+	/* Earlier runs hold earlier entries of the file */
+	return c < 0 || (c == 0 && a < b);
+}
+
+static void sift_down(SORT_RUNS *sr, int i)
+{
+	int c = 0;
+	int t = 0;
+
+	while ((c = 2 * i + 1) < sr->nheap)
+	{
+		if (c + 1 < sr->nheap && run_less(sr, sr->heap[c + 1], sr->heap[c]))
+			c++;
+		if (!run_less(sr, sr->heap[c], sr->heap[i]))
+			break;
+		t = sr->heap[i];
+		sr->heap[i] = sr->heap[c];
+		sr->heap[c] = t;
+		i = c;
+	}
+}
@@ -0,0 +1,265 @@
+/* file: stream_cache.c
+ * description: Least-recently-used cache of open sample output streams
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+#include "ddradseq.h"
+
+#define MAX_ATTEMPTS 100
+
+/* Function prototypes */
+static int stream_open(OUT_STREAM *os, FILE *lf);
+static int stream_evict(STREAM_CACHE *sc, FILE *lf);
+static void lru_unlink(STREAM_CACHE *sc, OUT_STREAM *os);
+static void lru_push(STREAM_CACHE *sc, OUT_STREAM *os);
+
+STREAM_CACHE *stream_cache_init(FILE *lf)
+{
+	int max_open = MAX_OPEN_STREAMS;
+	struct rlimit rl;
+	STREAM_CACHE *sc = NULL;
+
+	sc = malloc(sizeof(STREAM_CACHE));
+	if (UNLIKELY(!sc))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return NULL;
+	}
+
+	/* Leave descriptors for the input files and log */
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY &&
+	    rl.rlim_cur < (rlim_t)MAX_OPEN_STREAMS + FD_RESERVE)
+		max_open = (int)rl.rlim_cur - FD_RESERVE;
+	if (max_open < 1)
+		max_open = 1;
+
+	sc->head = NULL;
+	sc->tail = NULL;
+	sc->nopen = 0;
+	sc->max_open = max_open;
+	pthread_mutex_init(&sc->lock, NULL);
+	pthread_cond_init(&sc->released, NULL);
+	loginfo(lf, "Keeping up to %d sample output files open.\n", max_open);
+
+	return sc;
+}
+
+BGZF *stream_acquire(STREAM_CACHE *sc, OUT_STREAM *os, FILE *lf)
+{
+	BGZF *fp = NULL;
+
+	pthread_mutex_lock(&sc->lock);
+
+	/* A stream being evicted is opened again only once it is closed */
+	while (os->closing)
+		pthread_cond_wait(&sc->released, &sc->lock);
+	if (os->fp)
+		lru_unlink(sc, os);
+	else
+	{
+		/* Make room by closing the least recently used idle stream */
+		while (sc->nopen >= sc->max_open)
+		{
+			if (stream_evict(sc, lf))
+			{
+				pthread_mutex_unlock(&sc->lock);
+				return NULL;
+			}
+		}
+		if (stream_open(os, lf))
+		{
+			pthread_mutex_unlock(&sc->lock);
+			return NULL;
+		}
+		sc->nopen++;
+	}
+	lru_push(sc, os);
+	os->busy = true;
+	fp = os->fp;
+	pthread_mutex_unlock(&sc->lock);
+
+	return fp;
+}
+
+void stream_release(STREAM_CACHE *sc, OUT_STREAM *os)
+{
+	pthread_mutex_lock(&sc->lock);
+	os->busy = false;
+	pthread_cond_broadcast(&sc->released);
+	pthread_mutex_unlock(&sc->lock);
+}
+
+int stream_close(STREAM_CACHE *sc, OUT_STREAM *os, FILE *lf)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&sc->lock);
+	while (os->closing)
+		pthread_cond_wait(&sc->released, &sc->lock);
+	if (os->fp)
+	{
+		lru_unlink(sc, os);
+		sc->nopen--;
+
+		/* Closing the stream also releases the file lock */
+		ret = bgzf_close(os->fp);
+		os->fp = NULL;
+		if (ret)
+			logerror(lf, "%s:%d Problem closing output file \'%s\'.\n", __func__, __LINE__,
+			         os->filename);
+	}
+	pthread_mutex_unlock(&sc->lock);
+
+	return ret;
+}
+
+void stream_cache_destroy(STREAM_CACHE *sc)
+{
+	if (!sc)
+		return;
+	pthread_mutex_destroy(&sc->lock);
+	pthread_cond_destroy(&sc->released);
+	free(sc);
+}
+
+static int stream_open(OUT_STREAM *os, FILE *lf)
+{
+	int fd = 0;
+	int num_attempts = 0;
+	struct flock fl = {F_WRLCK, SEEK_SET, 0, 0, 0};
+	struct flock fl2;
+	mode_t mode;
+
+	fl.l_pid = getpid();
+	memset(&fl2, 0, sizeof(struct flock));
+
+	/* Set permissions if new output file needs to be created */
+	mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH;
+
+	/* Get output file descriptor */
+	fd = open(os->filename, O_WRONLY | O_CREAT | O_APPEND, mode);
+	if (fd < 0)
+	{
+		logerror(lf, "%s:%d Unable to open output file \'%s\': %s.\n", __func__,
+		         __LINE__, os->filename, strerror(errno));
+		return 1;
+	}
+
+	/* Test if output file has lock in 30 second intervals */
+	/* Will timeout after MAX_ATTEMPTS attempts to get a lock */
+	fcntl(fd, F_GETLK, &fl2);
+	num_attempts++;
+	while (fl2.l_type != F_UNLCK)
+	{
+		if (num_attempts > MAX_ATTEMPTS)
+		{
+			logerror(lf, "%s:%d File \'%s\' is still locked after %d attempts... exiting.\n", __func__,
+			         __LINE__, os->filename, num_attempts);
+			close(fd);
+			return 1;
+		}
+		else
+		{
+			sleep(30);
+			fcntl(fd, F_GETLK, &fl2);
+			num_attempts++;
+		}
+	}
+
+	/* Hold the lock for as long as the stream stays open */
+	if (fcntl(fd, F_SETLKW, &fl) == -1)
+	{
+		logerror(lf, "%s:%d Failed to set lock on file \'%s\': %s.\n", __func__,
+		         __LINE__, os->filename, strerror(errno));
+		close(fd);
+		return 1;
+	}
+
+	/* Blocks are compressed by the parse thread writing the stream */
+	os->fp = bgzf_dopen(fd, os->filename, NULL, lf);
+	if (!os->fp)
+	{
+		logerror(lf, "%s:%d Unable to open output stream \'%s\'.\n", __func__, __LINE__,
+		         os->filename);
+		close(fd);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int stream_evict(STREAM_CACHE *sc, FILE *lf)
+{
+	int ret = 0;
+	BGZF *fp = NULL;
+	OUT_STREAM *os = NULL;
+
+	/* Find the least recently used stream not being written */
+	for (os = sc->tail; os && os->busy; os = os->prev);
+	if (!os)
+	{
+		pthread_cond_wait(&sc->released, &sc->lock);
+		return 0;
+	}
+	lru_unlink(sc, os);
+	os->closing = true;
+	fp = os->fp;
+
+	/* The last block is compressed and the file closed without the lock, */
+	/* so other threads keep writing; the stream counts as open until then */
+	pthread_mutex_unlock(&sc->lock);
+	ret = bgzf_close(fp);
+	pthread_mutex_lock(&sc->lock);
+	os->fp = NULL;
+	os->closing = false;
+	sc->nopen--;
+	pthread_cond_broadcast(&sc->released);
+	if (ret)
+	{
+		logerror(lf, "%s:%d Problem closing output file \'%s\'.\n", __func__, __LINE__,
+		         os->filename);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void lru_unlink(STREAM_CACHE *sc, OUT_STREAM *os)
+{
+	if (os->prev)
+		os->prev->next = os->next;
+	else
+		sc->head = os->next;
+	if (os->next)
+		os->next->prev = os->prev;
+	else
+		sc->tail = os->prev;
+	os->prev = NULL;
+	os->next = NULL;
+}
+
+static void lru_push(STREAM_CACHE *sc, OUT_STREAM *os)
+{
+	os->prev = NULL;
+	os->next = sc->head;
+	if (sc->head)
+		sc->head->prev = os;
+	else
+		sc->tail = os;
+	sc->head = os;
+}
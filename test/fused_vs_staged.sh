@@ -0,0 +1,82 @@
+#!/bin/sh
+# file: fused_vs_staged.sh
+# description: Checks that a fused run writes the same final files as the three-stage run
+# author: Daniel Garrigan Lummei Analytics LLC
+# updated: October 2026
+# email: dgarriga@lummei.net
+# copyright: MIT license
+# note: Run from the program directory as test/fused_vs_staged.sh [DDRADSEQ].
+#       The bundled test.R1/R2.fastq.gz entries are rewritten as mates of
+#       simulated fragments, 150, 250 and 300 bases long, many of which are
+#       shorter than the reads and so have to be trimmed. Records are
+#       compared sorted, as the order differs between parse threads
+
+bin=$(cd "$(dirname "${1:-./ddradseq}")" && pwd)/$(basename "${1:-./ddradseq}")
+src=$(pwd)
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+mkdir "$tmp/in" "$tmp/staged" "$tmp/fused" "$tmp/fused_mt"
+zcat "$src/rad48.csv.gz" > "$tmp/db.csv"
+
+# Each entry keeps its identifiers and the barcode starting its forward read,
+# and is repeated on a new tile for every read length
+zcat "$src/test.R1.fastq.gz" > "$tmp/R1"
+zcat "$src/test.R2.fastq.gz" > "$tmp/R2"
+paste -d '\n' "$tmp/R1" "$tmp/R2" | awk -v dir="$tmp/in" '
+function rnd(n,   s, i) { s = ""; for (i = 0; i < n; i++) s = s substr("ACGT", int(rand() * 4) + 1, 1); return s }
+function rc(s,   r, i) { r = ""; for (i = length(s); i > 0; i--) r = r comp[substr(s, i, 1)]; return r }
+BEGIN { srand(1); comp["A"] = "T"; comp["C"] = "G"; comp["G"] = "C"; comp["T"] = "A"; comp["N"] = "N"; nl = split("150 250 300", rl, " ") }
+{ line[(NR - 1) % 8] = $0 }
+NR % 8 == 0 {
+	for (k = 1; k <= nl; k++)
+	{
+		len = rl[k]
+		n = 40 + int(rand() * (2 * len - 40))
+		frag = substr(line[2] rnd(n), 1, n)
+		fwd = substr(frag rnd(len), 1, len)
+		rev = substr(rc(frag) rnd(len), 1, len)
+		nf = split(line[0], f1, ":")
+		split(line[1], f2, ":")
+		f1[5] = f2[5] = 1100 + k
+		id1 = f1[1]; id2 = f2[1]
+		for (i = 2; i <= nf; i++) { id1 = id1 ":" f1[i]; id2 = id2 ":" f2[i] }
+		q = substr(sprintf("%" len "s", ""), 1, len); gsub(/ /, "F", q)
+		print id1 "\n" fwd "\n+\n" q > dir "/sim.R1.fastq"
+		print id2 "\n" rev "\n+\n" q > dir "/sim.R2.fastq"
+	}
+}'
+gzip "$tmp/in/sim.R1.fastq" "$tmp/in/sim.R2.fastq"
+
+# Run both ways; the log is written to the working directory
+cd "$tmp" || exit 1
+"$bin" -c db.csv -o staged in > /dev/null 2>&1 || { echo "Three-stage run failed."; exit 1; }
+"$bin" -f -c db.csv -o fused in > /dev/null 2>&1 || { echo "Fused run failed."; exit 1; }
+"$bin" -f -t 4 -c db.csv -o fused_mt in > /dev/null 2>&1 || { echo "Threaded fused run failed."; exit 1; }
+
+# Every final file must hold the same records
+ret=0
+nfiles=0
+for f in $(cd staged/* && find . -path '*/final/*' -name '*.fq.gz' | sort); do
+	nfiles=$((nfiles + 1))
+	want=$(zcat "staged/"*"/$f" | paste - - - - | sort | cksum)
+	for run in fused fused_mt; do
+		got=$(zcat "$run/"*"/$f" 2> /dev/null | paste - - - - | sort | cksum)
+		if [ "$want" != "$got" ]; then
+			echo "$run differs from the three-stage run in $f."
+			ret=1
+		fi
+	done
+done
+for run in fused fused_mt; do
+	if [ "$(cd $run/* && find . -path '*/final/*' -name '*.fq.gz' | wc -l)" -ne "$nfiles" ]; then
+		echo "$run wrote a different number of final files."
+		ret=1
+	fi
+done
+
+# And the check only means something if mates were trimmed
+ntrim=$(zcat staged/*/*/*/final/*.R2.fq.gz | awk 'NR % 4 == 2 && length($0) != 150 && length($0) != 250 && length($0) != 300' | wc -l)
+echo "$nfiles final files compared, $ntrim reverse reads trimmed."
+[ "$ntrim" -gt 0 ] || ret=1
+
+exit $ret
@@ -0,0 +1,208 @@
+/* file: trim_mates_test.c
+ * description: Checks that trimming mates in batches agrees with trimming them one at a time
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ * note: Built against every source file but ddradseq.c, from the program directory:
+ *       gcc -O2 -I. -o trim_mates_test test/trim_mates_test.c \
+ *           $(ls *.c | grep -v '^ddradseq.c$') -lz -pthread
+ *       It exits non-zero when any pair is trimmed differently, or when no
+ *       pair tested has its best alignment end in the padding of its query
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "ddradseq.h"
+
+/* Mate pairs simulated for each read length */
+#define NPAIRS 4000
+
+/* Ambiguous bases coded after each query, as trim_mate does */
+#define QUERY_SLACK 16
+
+/* Function prototypes */
+static int test_length(const CMD *cp, const int rl, ALIGN_WORK *w);
+static int ends_in_padding(const CMD *cp, const char *fseq, const int tlen, const char *rseq,
+                           const int qlen, ALIGN_WORK *w);
+static void random_seq(char *s, const int l);
+static uint64_t next_random(void);
+
+/* Globally scoped variables */
+extern const char seq_nt4_table[256];
+static uint64_t state = 0x9e3779b97f4a7c15ull;
+
+int main(void)
+{
+	int ret = 0;
+	CMD cp;
+	ALIGN_WORK w;
+
+	/* Trim as the program does by default */
+	memset(&cp, 0, sizeof(CMD));
+	cp.score = 100;
+	cp.gapo = 5;
+	cp.gape = 1;
+	cp.lf = stderr;
+	memset(&w, 0, sizeof(ALIGN_WORK));
+	align_batch_init(cp.lf);
+
+	ret |= test_length(&cp, 150, &w);
+	ret |= test_length(&cp, 250, &w);
+	ret |= test_length(&cp, 300, &w);
+	align_work_free(&w);
+
+	return ret;
+}
+
+static int test_length(const CMD *cp, const int rl, ALIGN_WORK *w)
+{
+	char *fseq = NULL;
+	char *rseq = NULL;
+	char *frag = NULL;
+	char *rc = NULL;
+	int i = 0;
+	int j = 0;
+	int n = 0;
+	int flen = 0;
+	int ndiff = 0;
+	int ntrim = 0;
+	int npad = 0;
+	size_t one = 0;
+	size_t rlen[ALIGN_LANES];
+	FASTQ_VIEW fv[ALIGN_LANES];
+	FASTQ_VIEW rv[ALIGN_LANES];
+	FASTQ_VIEW *fp[ALIGN_LANES];
+	FASTQ_VIEW *rp[ALIGN_LANES];
+
+	fseq = malloc((size_t)NPAIRS * (rl + 1));
+	rseq = malloc((size_t)NPAIRS * (rl + 1));
+	frag = malloc(2 * rl + 1);
+	if (!fseq || !rseq || !frag)
+	{
+		fprintf(stderr, "Memory allocation failure.\n");
+		return 1;
+	}
+
+	/* Each fragment is read from both ends, so mates of fragments */
+	/* shorter than the reads run on into the adapter */
+	for (i = 0; i < NPAIRS; i++)
+	{
+		char *f = fseq + (size_t)i * (rl + 1);
+		char *r = rseq + (size_t)i * (rl + 1);
+
+		flen = 40 + (int)(next_random() % (uint64_t)(2 * rl - 40));
+		random_seq(frag, flen);
+		frag[flen] = '\0';
+		rc = revcom(frag, cp->lf);
+		if (!rc)
+			return 1;
+		random_seq(f, rl);
+		random_seq(r, rl);
+		memcpy(f, frag, flen < rl ? flen : rl);
+		memcpy(r, rc, flen < rl ? flen : rl);
+		free(rc);
+
+		/* With a few sequencing errors */
+		for (j = 0; j < rl; j++)
+			if (next_random() % 100 == 0)
+				r[j] = "ACGT"[next_random() % 4];
+		f[rl] = '\0';
+		r[rl] = '\0';
+	}
+
+	/* Trim a batch at a time, then each pair of it on its own */
+	for (i = 0; i < NPAIRS; i += n)
+	{
+		n = NPAIRS - i < ALIGN_LANES ? NPAIRS - i : ALIGN_LANES;
+		for (j = 0; j < n; j++)
+		{
+			memset(&fv[j], 0, sizeof(FASTQ_VIEW));
+			memset(&rv[j], 0, sizeof(FASTQ_VIEW));
+			fv[j].seq = fseq + (size_t)(i + j) * (rl + 1);
+			fv[j].seq_len = (size_t)rl;
+			rv[j].seq = rseq + (size_t)(i + j) * (rl + 1);
+			rv[j].seq_len = (size_t)rl;
+			fp[j] = &fv[j];
+			rp[j] = &rv[j];
+		}
+		if (trim_mates(cp, fp, rp, n, rlen, w))
+			return 1;
+		for (j = 0; j < n; j++)
+		{
+			if (trim_mate(cp, fv[j].seq, fv[j].seq_len, rv[j].seq, &one, w))
+				return 1;
+			if (one != rlen[j])
+			{
+				fprintf(stderr, "Read length %d, pair %d: trim_mates leaves %zu bases, "
+				        "trim_mate %zu.\n", rl, i + j, rlen[j], one);
+				ndiff++;
+			}
+			if (one < (size_t)rl)
+			{
+				ntrim++;
+				npad += ends_in_padding(cp, fv[j].seq, rl, rv[j].seq, rl, w);
+			}
+		}
+	}
+	printf("Read length %d: %d pairs trimmed, %d ending in the query padding, "
+	       "%d trimmed differently.\n", rl, ntrim, npad, ndiff);
+
+	free(fseq);
+	free(rseq);
+	free(frag);
+
+	return ndiff > 0 || npad == 0;
+}
+
+static int ends_in_padding(const CMD *cp, const char *fseq, const int tlen, const char *rseq,
+                           const int qlen, ALIGN_WORK *w)
+{
+	int i = 0;
+	char *target = NULL;
+	char *query = NULL;
+	ALIGN_BATCH ab;
+
+	target = malloc((size_t)(tlen + qlen + QUERY_SLACK));
+	if (!target)
+		return 0;
+	query = target + tlen;
+	for (i = 0; i < tlen; i++)
+		target[i] = seq_nt4_table[(unsigned char)fseq[i]];
+	revcom_code(rseq, qlen, query, cp->lf);
+	for (i = qlen; i < qlen + QUERY_SLACK; i++)
+		query[i] = 4;
+
+	/* Where the best alignment ends before its start is looked for */
+	ab.n = 1;
+	ab.query[0] = query;
+	ab.qlen[0] = qlen;
+	ab.target[0] = target;
+	ab.tlen[0] = tlen;
+	ab.minsc[0] = cp->score;
+	ab.endsc[0] = 0x10000;
+	align_batch(&ab, 1, 3, cp->gapo, cp->gape, w, cp->lf);
+	free(target);
+
+	return ab.r[0].score < 255 && ab.r[0].query_end >= qlen;
+}
+
+static void random_seq(char *s, const int l)
+{
+	int i = 0;
+
+	for (i = 0; i < l; i++)
+		s[i] = "ACGT"[next_random() % 4];
+}
+
+static uint64_t next_random(void)
+{
+	/* xorshift64, so every run sees the same pairs */
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+
+	return state;
+}
@@ -0,0 +1,35 @@
+/* file: tokenize_fastq.c
+ * description: Tokenizes a fastQ entry in place within a block of null-delimited lines
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <string.h>
+#include "ddradseq.h"
+
+char *tokenize_fastq(char *buff, FASTQ_VIEW *v)
+{
+	char *q = buff;
+
+	/* Illumina identifier line */
+	v->id = q;
+	v->id_len = strlen(q);
+	q += v->id_len + 1u;
+
+	/* DNA sequence line */
+	v->seq = q;
+	v->seq_len = strlen(q);
+	q += v->seq_len + 1u;
+
+	/* Quality identifier line */
+	q += strlen(q) + 1u;
+
+	/* Quality sequence line */
+	v->qual = q;
+	v->qual_len = strlen(q);
+	q += v->qual_len + 1u;
+
+	return q;
+}
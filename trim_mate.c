@@ -0,0 +1,263 @@
+/* file: trim_mate.c
+ * description: Aligns pairs of mates and finds where to trim the 3' end of each reverse sequence
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "ddradseq.h"
+
+#define NBASES 4
+
+/* Scores of a matched and a mismatched base */
+#define MATCH 1
+#define MISMATCH 3
+
+/* Ambiguous bases after each query, as far as local_align's padding lets it read */
+#define QUERY_SLACK 16
+
+/* Function prototypes */
+static int code_mates(const char *fseq, const int tlen, const char *rseq, const int qlen,
+                      char *target, char *query, FILE *lf);
+static void reverse_codes(char *s, const int l);
+
+/* Globally scoped variables */
+const char seq_nt4_table[256] = {
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  3, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  3, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4
+};
+const char alpha[5] = "ACGTN";
+
+int trim_mate(const CMD *cp, const char *fseq, const size_t flen, const char *rseq,
+              size_t *rlen, ALIGN_WORK *w)
+{
+	char *target = NULL;
+	char *query = NULL;
+	char mat[25];
+	int i = 0;
+	int j = 0;
+	int k = 0;
+	int tlen = 0;
+	int qlen = 0;
+	int ret = 0;
+	const int sa = MATCH;
+	const int sb = MISMATCH;
+	ALIGN_RESULT r;
+	FILE *lf = cp->lf;
+
+	/* Initialize the scoring matrix */
+	for (i = k = 0; i < NBASES; i++)
+	{
+		for (j = 0; j < NBASES; j++)
+			mat[k++] = (i == j) ? sa : -sb;
+
+		/* Ambiguous base */
+		mat[k++] = 0;
+	}
+	for (j = 0; j <= NBASES; j++)
+		mat[k++] = 0;
+
+	/* The forward sequence is the target, the reverse complement the query */
+	tlen = (int)flen;
+	qlen = (int)strcspn(rseq, "\n");
+	target = grow_buffer(&w->seq, &w->seq_size, (size_t)(tlen + qlen + QUERY_SLACK));
+	if (UNLIKELY(!target))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return 1;
+	}
+	query = target + tlen;
+	if (code_mates(fseq, tlen, rseq, qlen, target, query, lf))
+		return 1;
+
+	/* Only pairs that might align well enough to be trimmed are aligned */
+	*rlen = (size_t)qlen;
+	if (!seed_filter(query, qlen, target, tlen, cp->score, sa, sb, cp->gapo, cp->gape))
+		return 0;
+
+	/* Given the insert sizes, only an overlap in their band is sought */
+	if (cp->insert_max > 0)
+	{
+		ret = overlap_align(query, qlen, target, tlen, qlen - cp->insert_max,
+		                    qlen - cp->insert_min, cp->score, sa, sb, cp->gapo, cp->gape, &r, w,
+		                    lf);
+		if (ret)
+			return 1;
+		if (r.score >= cp->score && r.query_begin > 0)
+			*rlen = (size_t)(qlen - r.query_begin);
+		return 0;
+	}
+
+	/* Do the alignment */
+	r = local_align(qlen, query, tlen, target, mat, cp->gapo, cp->gape, KSW_XSTART, w, lf);
+
+	/* Trim the reverse sequence where it runs past the start of the forward */
+	if (r.score >= cp->score && r.target_begin == 0 && r.query_begin > 0)
+		*rlen = (size_t)(qlen - r.query_begin);
+
+	return 0;
+}
+
+int trim_mates(const CMD *cp, FASTQ_VIEW **fv, FASTQ_VIEW **rv, const int n, size_t *rlen,
+               ALIGN_WORK *w)
+{
+	char *target[ALIGN_LANES];
+	char *query[ALIGN_LANES];
+	char *code = NULL;
+	bool scalar[ALIGN_LANES];
+	int pair[ALIGN_LANES];
+	int k = 0;
+	int l = 0;
+	int qb = 0;
+	int tb = 0;
+	int qlen = 0;
+	int tlen = 0;
+	size_t need = 0;
+	ALIGN_RESULT r[ALIGN_LANES];
+	ALIGN_BATCH ab;
+	FILE *lf = cp->lf;
+
+	/* Without a gap opening penalty local_align can end its lazy-F loop early, */
+	/* which the batch does not copy, and overlap alignments are not batched */
+	if (cp->gapo <= 0 || cp->insert_max > 0)
+	{
+		for (l = 0; l < n; l++)
+			if (trim_mate(cp, fv[l]->seq, fv[l]->seq_len, rv[l]->seq, &rlen[l], w))
+				return 1;
+		return 0;
+	}
+
+	/* Code the forward sequences and the reverse complements as in trim_mate, */
+	/* all in one buffer */
+	for (l = 0; l < n; l++)
+		need += fv[l]->seq_len + rv[l]->seq_len + QUERY_SLACK;
+	code = grow_buffer(&w->seq, &w->seq_size, need);
+	if (UNLIKELY(!code))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		return 1;
+	}
+	ab.n = 0;
+	for (l = 0; l < n; l++)
+	{
+		tlen = (int)fv[l]->seq_len;
+		qlen = (int)rv[l]->seq_len;
+		target[l] = code;
+		query[l] = code + tlen;
+		code += tlen + qlen + QUERY_SLACK;
+		if (code_mates(fv[l]->seq, tlen, rv[l]->seq, qlen, target[l], query[l], lf))
+			return 1;
+		rlen[l] = (size_t)qlen;
+
+		/* Pairs that cannot align well enough to be trimmed take no lane */
+		if (!seed_filter(query[l], qlen, target[l], tlen, cp->score, MATCH, MISMATCH,
+		                 cp->gapo, cp->gape))
+			continue;
+		k = ab.n++;
+		pair[k] = l;
+		ab.query[k] = query[l];
+		ab.qlen[k] = qlen;
+		ab.target[k] = target[l];
+		ab.tlen[k] = tlen;
+		ab.minsc[k] = cp->score;
+		ab.endsc[k] = 0x10000;
+	}
+	if (ab.n == 0)
+		return 0;
+
+	/* Find the end of each best alignment */
+	if (align_batch(&ab, MATCH, MISMATCH, cp->gapo, cp->gape, w, lf))
+		return 1;
+
+	/* Then its start, by aligning the reversed prefixes until the score is reached */
+	for (k = 0; k < ab.n; k++)
+	{
+		r[k] = ab.r[k];
+
+		/* Saturated alignments are left to local_align and its 16-bit scores, */
+		/* while weak ones are not trimmed; one ending in the padding is */
+		/* reversed over the ambiguous bases after its query, as local_align does */
+		scalar[k] = r[k].score == 255;
+		if (scalar[k] || r[k].score < cp->score)
+		{
+			ab.qlen[k] = 0;
+			ab.tlen[k] = 0;
+			continue;
+		}
+		reverse_codes(query[pair[k]], r[k].query_end + 1);
+		reverse_codes(target[pair[k]], r[k].target_end + 1);
+		ab.qlen[k] = r[k].query_end + 1;
+		ab.minsc[k] = r[k].score;
+		ab.endsc[k] = r[k].score;
+	}
+	if (align_batch(&ab, MATCH, MISMATCH, cp->gapo, cp->gape, w, lf))
+		return 1;
+
+	/* Trim the reverse sequence where it runs past the start of the forward; */
+	/* trim_mate codes its pair over the buffer, which the batch is done with */
+	for (k = 0; k < ab.n; k++)
+	{
+		l = pair[k];
+		if (scalar[k])
+		{
+			if (trim_mate(cp, fv[l]->seq, fv[l]->seq_len, rv[l]->seq, &rlen[l], w))
+				return 1;
+			continue;
+		}
+		if (ab.tlen[k] == 0 || ab.r[k].score != r[k].score)
+			continue;
+		tb = r[k].target_end - ab.r[k].target_end;
+		qb = r[k].query_end - ab.r[k].query_end;
+		if (tb == 0 && qb > 0)
+			rlen[l] -= (size_t)qb;
+	}
+
+	return 0;
+}
+
+static int code_mates(const char *fseq, const int tlen, const char *rseq, const int qlen,
+                      char *target, char *query, FILE *lf)
+{
+	int i = 0;
+
+	for (i = 0; i < tlen; i++)
+		target[i] = seq_nt4_table[(unsigned char)fseq[i]];
+	if (revcom_code(rseq, qlen, query, lf))
+		return 1;
+	for (i = qlen; i < qlen + QUERY_SLACK; i++)
+		query[i] = 4;
+
+	return 0;
+}
+
+static void reverse_codes(char *s, const int l)
+{
+	int i = 0;
+	char t = 0;
+
+	for (i = 0; i < l >> 1; i++)
+	{
+		t = s[i];
+		s[i] = s[l - 1 - i];
+		s[l - 1 - i] = t;
+	}
+}
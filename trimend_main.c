@@ -11,14 +11,18 @@
 #include <string.h>
 #include "ddradseq.h"
 
+/* Function prototypes */
+static int trim_sample(const CMD *cp, BGZF_POOL *bp, const char *fin, const char *rin, void *arg);
+
 int trimend_main(const CMD *cp)
 {
-	char *pch = NULL;
 	char **filelist = NULL;
 	int ret = 0;
 	unsigned int i = 0;
 	unsigned int nfiles = 0;
 	FILE *lf = cp->lf;
+	BGZF_POOL *bp = NULL;
+	ALIGN_SLOTS *as = NULL;
 
 	/* Print informational message to log file */
 	loginfo(lf, "Beginning to trim 3\' end of reverse sequences in \'%s\'.\n", cp->outdir);
@@ -31,59 +35,38 @@ int trimend_main(const CMD *cp)
 	if (nfiles < 1)
 	{
 		logerror(lf, "%s:%d No input fastQ files found.\n", __func__, __LINE__);
-		return 1;
+		ret = 1;
+		goto cleanup;
+	}
+
+	/* Output blocks are compressed while the next entries are processed; */
+	/* each sample run at once writes two files */
+	bp = bgzf_pool_init(cp->nthreads, 2 * sample_workers(cp, nfiles), lf);
+	if (!bp)
+	{
+		ret = 1;
+		goto cleanup;
 	}
 
-	for (i = 0; i < nfiles; i += 2)
+	/* Align with the widest vectors the processor runs, unless only overlaps are sought */
+	if (cp->insert_max > 0)
+		loginfo(lf, "Trimming by overlap alignment for inserts of %d to %d bases.\n",
+		        cp->insert_min, cp->insert_max);
+	else
+		align_batch_init(lf);
+
+	/* Several samples are aligned at once, sharing the threads evenly until */
+	/* the last has started, then taking on those of the samples that finish */
+	as = align_slots_init(cp->nthreads, (int)(nfiles / 2u), sample_workers(cp, nfiles));
+	if (UNLIKELY(!as))
 	{
-		char *ffor = NULL;
-		char *frev = NULL;
-		size_t spn = 0;
-
-		/* Construct output file names */
-		ffor = strdup(filelist[i]);
-		if (UNLIKELY(!ffor))
-		{
-			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-			return 1;
-		}
-		frev = strdup(filelist[i+1]);
-		if (UNLIKELY(!frev))
-		{
-			logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
-			return 1;
-		}
-		pch = strstr(ffor, "pairs");
-		if (!pch)
-			return 1;
-		strncpy(pch, "final", DNAME_LENGTH);
-		pch = strstr(frev, "pairs");
-		if (!pch)
-			return 1;
-		strncpy(pch, "final", DNAME_LENGTH);
-
-		/* Double-check that files are mates */
-		spn = strcspn(ffor, ".");
-		ret = strncmp(ffor, frev, spn);
-		if (ret)
-		{
-			logerror(lf, "%s:%d Files \'%s\' and \'%s\' do not appear to be mate-"
-				     "pairs.\n", __func__, __LINE__, ffor, frev);
-			return 1;
-		}
-
-		/* Print informational update to log file */
-		loginfo(lf, "Attempting to align sequences in \'%s\' and \'%s\'.\n", ffor, frev);
-
-		/* Align mated pairs and write to output file*/
-		ret = align_mates(cp, filelist[i], filelist[i+1], ffor, frev);
-		if (ret)
-			return 1;
-
-		/* Free allocated memory */
-		free(ffor);
-		free(frev);
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		ret = 1;
+		goto cleanup;
 	}
+	ret = run_samples(cp, bp, filelist, nfiles, trim_sample, as);
+	if (ret)
+		goto cleanup;
 
 	/* Print informational message to log file */
 	if (string_equal(cp->mode, "trimend"))
@@ -91,10 +74,77 @@ int trimend_main(const CMD *cp)
 	else
 		loginfo(lf, "Done trimming 3\' end of reverse sequences in \'%s\'.\n", cp->outdir);
 
+cleanup:
 	/* Deallocate memory */
+	align_slots_destroy(as);
+	bgzf_pool_destroy(bp);
 	for (i = 0; i < nfiles; i++)
 		free(filelist[i]);
 	free(filelist);
 
-	return 0;
+	return ret ? 1 : 0;
+}
+
+static int trim_sample(const CMD *cp, BGZF_POOL *bp, const char *fin, const char *rin, void *arg)
+{
+	char *pch = NULL;
+	char *ffor = NULL;
+	char *frev = NULL;
+	int ret = 0;
+	ALIGN_SLOTS *as = (ALIGN_SLOTS*)arg;
+	size_t spn = 0;
+	FILE *lf = cp->lf;
+
+	/* Construct output file names */
+	ffor = strdup(fin);
+	if (UNLIKELY(!ffor))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		ret = 1;
+		goto cleanup;
+	}
+	frev = strdup(rin);
+	if (UNLIKELY(!frev))
+	{
+		logerror(lf, "%s:%d Memory allocation failure.\n", __func__, __LINE__);
+		ret = 1;
+		goto cleanup;
+	}
+	pch = strstr(ffor, "pairs");
+	if (!pch)
+	{
+		ret = 1;
+		goto cleanup;
+	}
+	strncpy(pch, "final", DNAME_LENGTH);
+	pch = strstr(frev, "pairs");
+	if (!pch)
+	{
+		ret = 1;
+		goto cleanup;
+	}
+	strncpy(pch, "final", DNAME_LENGTH);
+
+	/* Double-check that files are mates */
+	spn = strcspn(ffor, ".");
+	ret = strncmp(ffor, frev, spn);
+	if (ret)
+	{
+		logerror(lf, "%s:%d Files \'%s\' and \'%s\' do not appear to be mate-"
+			     "pairs.\n", __func__, __LINE__, ffor, frev);
+		goto cleanup;
+	}
+
+	/* Print informational update to log file */
+	loginfo(lf, "Attempting to align sequences in \'%s\' and \'%s\'.\n", ffor, frev);
+
+	/* Align mated pairs and write to output file*/
+	ret = align_mates(cp, bp, as, fin, rin, ffor, frev);
+
+cleanup:
+	/* Free allocated memory */
+	free(ffor);
+	free(frev);
+
+	return ret ? 1 : 0;
 }
@@ -0,0 +1,97 @@
+/* file: work_queue.c
+ * description: Bounded producer/consumer queue for passing work between threads
+ * author: Daniel Garrigan Lummei Analytics LLC
+ * updated: October 2026
+ * email: dgarriga@lummei.net
+ * copyright: MIT license
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "ddradseq.h"
+
+WORK_QUEUE *queue_init(const int size)
+{
+	WORK_QUEUE *wq = NULL;
+
+	wq = malloc(sizeof(WORK_QUEUE));
+	if (UNLIKELY(!wq))
+		return NULL;
+	wq->items = malloc(size * sizeof(void*));
+	if (UNLIKELY(!wq->items))
+	{
+		free(wq);
+		return NULL;
+	}
+	wq->size = size;
+	wq->head = 0;
+	wq->count = 0;
+	wq->closed = false;
+	pthread_mutex_init(&wq->lock, NULL);
+	pthread_cond_init(&wq->not_empty, NULL);
+	pthread_cond_init(&wq->not_full, NULL);
+
+	return wq;
+}
+
+int queue_push(WORK_QUEUE *wq, void *item)
+{
+	pthread_mutex_lock(&wq->lock);
+
+	/* Wait for a free slot in the queue */
+	while (wq->count == wq->size && !wq->closed)
+		pthread_cond_wait(&wq->not_full, &wq->lock);
+	if (wq->closed)
+	{
+		pthread_mutex_unlock(&wq->lock);
+		return 1;
+	}
+	wq->items[(wq->head + wq->count) % wq->size] = item;
+	wq->count++;
+	pthread_cond_signal(&wq->not_empty);
+	pthread_mutex_unlock(&wq->lock);
+
+	return 0;
+}
+
+void *queue_pop(WORK_QUEUE *wq)
+{
+	void *item = NULL;
+
+	pthread_mutex_lock(&wq->lock);
+
+	/* Wait for an item or for the producer to close the queue */
+	while (wq->count == 0 && !wq->closed)
+		pthread_cond_wait(&wq->not_empty, &wq->lock);
+	if (wq->count > 0)
+	{
+		item = wq->items[wq->head];
+		wq->head = (wq->head + 1) % wq->size;
+		wq->count--;
+		pthread_cond_signal(&wq->not_full);
+	}
+	pthread_mutex_unlock(&wq->lock);
+
+	return item;
+}
+
+void queue_close(WORK_QUEUE *wq)
+{
+	pthread_mutex_lock(&wq->lock);
+	wq->closed = true;
+	pthread_cond_broadcast(&wq->not_empty);
+	pthread_cond_broadcast(&wq->not_full);
+	pthread_mutex_unlock(&wq->lock);
+}
+
+void queue_destroy(WORK_QUEUE *wq)
+{
+	if (!wq)
+		return;
+	pthread_mutex_destroy(&wq->lock);
+	pthread_cond_destroy(&wq->not_empty);
+	pthread_cond_destroy(&wq->not_full);
+	free(wq->items);
+	free(wq);
+}
@@ -19,6 +19,9 @@ void logerror(FILE *lf, const char *format, ...)
 	/* Update time string */
 	get_timestr(&timestr[0]);
 
+	/* Keep the prefix and message together when threads log at once */
+	flockfile(stderr);
+	flockfile(lf);
 	fprintf(stderr, "[ddradseq: %s] ERROR -- ", timestr);
 	fprintf(lf, "[ddradseq: %s] ERROR -- ", timestr);
 	va_start(ap, format);
@@ -26,7 +29,10 @@ void logerror(FILE *lf, const char *format, ...)
 	vfprintf(stderr, format, ap);
 	vfprintf(lf, format, copy);
 	va_end(ap);
+	va_end(copy);
 	fflush(lf);
+	funlockfile(lf);
+	funlockfile(stderr);
 }
 
 void loginfo(FILE *lf, const char *format, ...)
@@ -37,10 +43,12 @@ void loginfo(FILE *lf, const char *format, ...)
 	/* Update time string */
 	get_timestr(&timestr[0]);
 
+	flockfile(lf);
 	fprintf(lf, "[ddradseq: %s] INFO -- ", timestr);
 	va_start(ap, format);
 	vfprintf(lf, format, ap);
 	va_end(ap);
+	funlockfile(lf);
 }
 
 void logwarn(FILE *lf, const char *format, ...)
@@ -51,10 +59,12 @@ void logwarn(FILE *lf, const char *format, ...)
 	/* Update time string */
 	get_timestr(&timestr[0]);
 
+	flockfile(lf);
 	fprintf(lf, "[ddradseq: %s] WARNING -- ", timestr);
 	va_start(ap, format);
 	vfprintf(lf, format, ap);
 	va_end(ap);
+	funlockfile(lf);
 }
 
 void error(const char *format, ...)